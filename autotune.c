@@ -0,0 +1,223 @@
+/*
+ * autotune.c - Searches transpose_blocked's parameters for the fewest simulated misses
+ *
+ * For each matrix shape, every combination of block width and height (1 to MAX_BLOCK), block order and diagonal
+ * handling is run the way test-trans runs a transpose function: through tracegen, with its references recorded in
+ * process (see tracerec.h) and fed to an LRU simulator of the target cache. The best configuration for each shape is
+ * written out as a trans_table.h, which transpose_submit dispatches on, if it has fewer misses than transpose_untuned,
+ * which transpose_submit falls back on for shapes without an entry.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cachelab.h"
+#include "simulator.h"
+#include "tracerec.h"
+
+//Largest block width and height tried
+#define MAX_BLOCK 16
+
+//Most matrix shapes tuned in one run
+#define MAX_SHAPES 16
+
+//External functions and markers defined in trans.c and tracegen.c, which are linked in built with -fsanitize=thread
+extern void transpose_untuned(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int block_width, int block_height, int order,
+                              int diag);
+extern volatile char MARKER_START, MARKER_END;
+extern void tracegen_init(int rows, int cols, int depth);
+extern int tracegen_run(int fn);
+
+//External variables defined in cachelab.c
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+
+/**
+ * Struct holding one set of transpose_blocked parameters.
+ * @param block_width columns of A per block
+ * @param block_height rows of A per block
+ * @param order 0 to visit blocks row by row, 1 column by column
+ * @param diag whether to hold back the diagonal element of each row
+ */
+typedef struct tune_config {
+    int block_width;
+    int block_height;
+    int order;
+    int diag;
+} tune_config;
+
+//Configuration run_candidate passes on. This file is not instrumented, so reading it is not part of the trace.
+static tune_config candidate;
+
+/**
+ * Transpose function registered with tracegen that runs the current candidate.
+ */
+static void run_candidate(int M, int N, int A[N][M], int B[M][N]) {
+    transpose_blocked(M, N, A, B, candidate.block_width, candidate.block_height, candidate.order, candidate.diag);
+}
+
+/**
+ * Runs a registered transpose function at the size tracegen was last set up for, and simulates its references.
+ * @param sim simulator of the target cache
+ * @param fn index of the function in func_list
+ * @return the number of misses, or -1 if the function's result was wrong
+ */
+static int count_misses(simulator *sim, int fn) {
+    cache_performance perf;
+    int count;
+
+    tracerec_begin(&MARKER_START, &MARKER_END);
+    int correct = tracegen_run(fn);
+    trace_ref *refs = tracerec_end(&count);
+    if(!correct) {
+        return -1;
+    }
+
+    simulator_reset(sim);
+    simulator_feed(sim, refs, count);
+    simulator_stats(sim, &perf);
+    return perf.misses;
+}
+
+void print_usage() {
+    printf("Usage: ./autotune [-h] [-s <s> -E <E> -b <b>] [-o <file>] -S <rows>x<cols>[,...]\n");
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -s <s>      Number of set index bits of the target cache (default 5).\n");
+    printf("  -E <E>      Number of lines per set (default 1).\n");
+    printf("  -b <b>      Number of block offset bits (default 5).\n");
+    printf("  -S <sizes>  Comma separated matrix sizes to tune for (max %d).\n", MAX_SHAPES);
+    printf("  -o <file>   Write the table to file instead of stdout.\n");
+    printf("Example: ./autotune -S 61x67,67x61 -o trans_table.h\n");
+}
+
+int main(int argc, char *argv[]) {
+    int s = 5;
+    int E = 1;
+    int b = 5;
+    int sizes[MAX_SHAPES][2];
+    int num_sizes = 0;
+    char *out_path = NULL;
+    char *p;
+    int opt;
+
+    while((opt = getopt(argc, argv, "hs:E:b:S:o:")) != -1) {
+        switch(opt) {
+            case 's':
+                s = strtol(optarg, &p, 10);
+                break;
+            case 'E':
+                E = strtol(optarg, &p, 10);
+                break;
+            case 'b':
+                b = strtol(optarg, &p, 10);
+                break;
+            case 'S':
+                for(p = optarg; *p; p++) {
+                    if(num_sizes == MAX_SHAPES || sscanf(p, "%dx%d", &sizes[num_sizes][0], &sizes[num_sizes][1]) != 2 ||
+                       sizes[num_sizes][0] < 1 || sizes[num_sizes][0] > 256 ||
+                       sizes[num_sizes][1] < 1 || sizes[num_sizes][1] > 256) {
+                        printf("Invalid matrix sizes \"%s\".\n", optarg);
+                        exit(0);
+                    }
+                    num_sizes++;
+                    if(!(p = strchr(p, ','))) {
+                        break;
+                    }
+                }
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'h':
+            default:
+                print_usage();
+                exit(0);
+        }
+    }
+
+    if(num_sizes == 0) {
+        print_usage();
+        exit(0);
+    }
+
+    simulator *sim = simulator_create(s, E, b, POLICY_LRU);
+    if(sim == NULL) {
+        printf("Invalid cache geometry s=%d E=%d b=%d.\n", s, E, b);
+        exit(0);
+    }
+
+    FILE *out = stdout;
+    if(out_path != NULL) {
+        out = fopen(out_path, "w");
+        if(out == NULL) {
+            printf("Unable to write \"%s\".\n", out_path);
+            exit(0);
+        }
+    }
+
+    //Register what transpose_submit does without a table entry, to compare against, and then the candidate
+    registerTransFunction(transpose_untuned, "Untuned transpose submission");
+    int untuned_fn = func_counter - 1;
+    registerTransFunction(run_candidate, "Autotune candidate");
+    int candidate_fn = func_counter - 1;
+
+    fprintf(out, "/*\n");
+    fprintf(out, " * trans_table.h - Blocking for transpose_submit, written by autotune\n");
+    fprintf(out, " *\n");
+    fprintf(out, " * Each TRANS_ENTRY(M, N, block_width, block_height, order, diag) gives\n");
+    fprintf(out, " * the transpose_blocked parameters with the fewest simulated misses for\n");
+    fprintf(out, " * one matrix shape, and takes precedence over transpose_submit's own\n");
+    fprintf(out, " * kernels. Shapes without an entry use those; autotune leaves out shapes\n");
+    fprintf(out, " * it cannot improve on. Tuned for s=%d, E=%d, b=%d.\n", s, E, b);
+    fprintf(out, " */\n\n");
+    fprintf(out, "#ifndef TRANS_TABLE_H\n#define TRANS_TABLE_H\n\n");
+    fprintf(out, "#define TRANS_TABLE \\\n");
+
+    for(int i = 0; i < num_sizes; i++) {
+        int M = sizes[i][0];
+        int N = sizes[i][1];
+        tracegen_init(M, N, M);
+
+        //Try every configuration, keeping the first with the fewest misses
+        tune_config best = {0, 0, 0, 0};
+        int best_misses = -1;
+        for(int width = 1; width <= MAX_BLOCK; width++) {
+            for(int height = 1; height <= MAX_BLOCK; height++) {
+                for(int order = 0; order <= 1; order++) {
+                    for(int diag = 0; diag <= 1; diag++) {
+                        candidate = (tune_config) {width, height, order, diag};
+                        int misses = count_misses(sim, candidate_fn);
+                        if(misses >= 0 && (best_misses == -1 || misses < best_misses)) {
+                            best = candidate;
+                            best_misses = misses;
+                        }
+                    }
+                }
+            }
+        }
+
+        //An entry takes precedence over transpose_submit's own kernels, so only write one that beats them
+        int untuned_misses = count_misses(sim, untuned_fn);
+        bool improves = best_misses >= 0 && (untuned_misses < 0 || best_misses < untuned_misses);
+        if(improves) {
+            fprintf(out, "    TRANS_ENTRY(%d, %d, %d, %d, %d, %d) /* %d misses */ \\\n", M, N, best.block_width,
+                    best.block_height, best.order, best.diag, best_misses);
+        }
+        if(out != stdout) {
+            printf("%dx%d: %dx%d blocks, order %d, diag %d: %d misses (untuned transpose_submit: %d)%s\n", M, N,
+                   best.block_width, best.block_height, best.order, best.diag, best_misses, untuned_misses,
+                   improves ? "" : ", no entry written");
+        }
+    }
+
+    fprintf(out, "\n\n#endif /* TRANS_TABLE_H */\n");
+    if(out != stdout) {
+        fclose(out);
+    }
+    simulator_free(&sim);
+    return 0;
+}
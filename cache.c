@@ -0,0 +1,550 @@
+/*
+ * cache.c - Flat set/way simulation core used by csim
+ */
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Names accepted by -p, indexed by enum ReplacementPolicy
+static const char *policy_names[] = {"lru", "fifo", "random", "plru", "srrip", "brrip", "lfu"};
+
+/* Largest RRPV for SRRIP and BRRIP (2-bit counters) */
+#define RRPV_MAX 3
+
+/**
+ * Allocates the entire cache. Tags, stamps, per-set policy state, per-line policy values, valid bits and dirty bits for
+ * every line are carved out of a single allocation.
+ * @param sim_cache filled in with the newly allocated cache
+ * @param sbits number of set index bits (s)
+ * @param lines_per_set number of lines per set (E)
+ * @param bytes_per_line number of block offset bits (b)
+ * @param tbits number of tag bits
+ * @param policy replacement policy
+ */
+void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits,
+                 enum ReplacementPolicy policy) {
+    *sim_cache = (cache *) malloc(sizeof(cache));
+
+    //Pass along all of the command line arguments
+    (*sim_cache)->sbits = sbits;
+    (*sim_cache)->lines_per_set = lines_per_set;
+    (*sim_cache)->bytes_per_line = bytes_per_line;
+    (*sim_cache)->tbits = 64 - (sbits + bytes_per_line);
+    (*sim_cache)->num_sets = 1 << sbits;
+    (*sim_cache)->split_lines = false;
+    (*sim_cache)->policy = policy;
+    (*sim_cache)->write_hit = WRITE_BACK;
+    (*sim_cache)->write_miss = WRITE_ALLOCATE;
+
+    //One block holds the tag, stamp and set state arrays, then the per-line policy values, then the valid and dirty
+    //    bytes. Ordering by element size keeps every array aligned.
+    size_t num_sets = (*sim_cache)->num_sets;
+    size_t num_lines = num_sets * lines_per_set;
+    char *block = malloc(num_lines * (2 * sizeof(unsigned long long) + sizeof(unsigned int) +
+                                      2 * sizeof(unsigned char)) + num_sets * sizeof(unsigned long long));
+    (*sim_cache)->tags = (unsigned long long *) block;
+    (*sim_cache)->stamps = (*sim_cache)->tags + num_lines;
+    (*sim_cache)->set_state = (*sim_cache)->stamps + num_lines;
+    (*sim_cache)->meta = (unsigned int *) ((*sim_cache)->set_state + num_sets);
+    (*sim_cache)->valid = (unsigned char *) ((*sim_cache)->meta + num_lines);
+    (*sim_cache)->dirty = (*sim_cache)->valid + num_lines;
+
+    reset_cache(*sim_cache);
+}
+
+/**
+ * Seeds a per-set random number generator (splitmix64 of the set index, which is never 0).
+ * @param set_id set to seed
+ * @return initial generator state
+ */
+static unsigned long long seed_set(unsigned long long set_id) {
+    unsigned long long z = (set_id + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z != 0 ? z : 1;
+}
+
+/**
+ * Invalidates every line and restarts the LRU clock and policy state, leaving the geometry untouched.
+ * @param sim_cache cache to reset
+ */
+void reset_cache(cache *sim_cache) {
+    size_t num_lines = (size_t) sim_cache->num_sets * sim_cache->lines_per_set;
+    memset(sim_cache->valid, 0, num_lines);
+    memset(sim_cache->dirty, 0, num_lines);
+    memset(sim_cache->stamps, 0, num_lines * sizeof(unsigned long long));
+    memset(sim_cache->meta, 0, num_lines * sizeof(unsigned int));
+    for(int i = 0; i < sim_cache->num_sets; i++) {
+        sim_cache->set_state[i] = sim_cache->policy == POLICY_PLRU ? 0 : seed_set(i);
+    }
+    sim_cache->clock = 0;
+}
+
+void free_cache(cache **sim_cache) {
+    //The tag array is the start of the single line allocation
+    free((*sim_cache)->tags);
+    free(*sim_cache);
+    *sim_cache = NULL;
+}
+
+/**
+ * Separate the tag and set from an address, given s and t to determine set and tag sizes. The block offset takes up
+ * the remaining 64 - (t + s) bits. s and b may each be 0; t is at least 1 since s + b < 64.
+ * @param loc location struct to fill in with the result
+ * @param address location in memory to parse into tag and set
+ * @param tbits number of bits the tag takes up
+ * @param sbits number of bits the set takes up
+ * @return fills in the loc struct with the tag and set id
+ */
+void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits) {
+    int bbits = 64 - (tbits + sbits);
+
+    //The tag is everything above the set and block offset bits. t is at least 1, so the shift stays below 64.
+    loc->tag_id = address >> (bbits + sbits);
+
+    //The set bits sit just above the block offset. For s = 0 the mask is empty and every address maps to set 0.
+    unsigned long long set_mask = (1ULL << sbits) - 1;
+    loc->set_id = (int) ((address >> bbits) & set_mask);
+}
+
+/**
+ * Advances a set's xorshift64 generator.
+ * @param state generator state, updated
+ * @return next random number
+ */
+static inline unsigned long long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * LRU, FIFO and LFU: finds a hit, the first empty line and the victim all in a single pass over the set's lines.
+ * LRU and LFU refresh a line's stamp on every hit, FIFO only when the line is filled. LFU evicts the line with the
+ * fewest uses, falling back to the oldest stamp on a tie.
+ * Each caller passes policy as a constant so the compiler builds a separate loop for each of the three.
+ * @param sim_cache cache to search through
+ * @param base index of the set's first line
+ * @param tag_id tag to look up
+ * @param policy POLICY_LRU, POLICY_FIFO or POLICY_LFU
+ * @return HIT, COLD_MISS, or MISS
+ */
+static inline __attribute__((always_inline)) enum HitOrMiss scan_stamped(cache *sim_cache, size_t base,
+                                                                          unsigned long long tag_id,
+                                                                          enum ReplacementPolicy policy) {
+    int lines_per_set = sim_cache->lines_per_set;
+
+    //Pointers to this set's slice of each line array
+    unsigned long long *tags = sim_cache->tags + base;
+    unsigned long long *stamps = sim_cache->stamps + base;
+    unsigned int *uses = sim_cache->meta + base;
+    unsigned char *valid = sim_cache->valid + base;
+
+    int empty = -1;
+    int victim = 0;
+
+    for (int i = 0; i < lines_per_set; i++) {
+        if (!valid[i]) {
+            //Remember the first empty line in case this turns out to be a cold miss
+            if (empty < 0) {
+                empty = i;
+            }
+            continue;
+        }
+
+        //If we have a match, we have a hit. Refresh its stamp (and count) and return.
+        if (tags[i] == tag_id) {
+            if (policy != POLICY_FIFO) {
+                stamps[i] = ++sim_cache->clock;
+            }
+            if (policy == POLICY_LFU) {
+                uses[i]++;
+            }
+            return HIT;
+        }
+
+        if (policy == POLICY_LFU && uses[i] != uses[victim]) {
+            if (uses[i] < uses[victim]) {
+                victim = i;
+            }
+        } else if (stamps[i] < stamps[victim]) {
+            victim = i;
+        }
+    }
+
+    //Fill an empty line if there is one, otherwise replace the victim
+    int way = empty >= 0 ? empty : victim;
+    tags[way] = tag_id;
+    stamps[way] = ++sim_cache->clock;
+    valid[way] = 1;
+    if (policy == POLICY_LFU) {
+        uses[way] = 1;
+    }
+
+    return empty >= 0 ? COLD_MISS : MISS;
+}
+
+/**
+ * Finds the line holding tag_id, and the first empty line in case there is none.
+ * @param sim_cache cache to search through
+ * @param base index of the set's first line
+ * @param tag_id tag to look up
+ * @param empty filled in with the first empty line, or -1 if the set is full
+ * @return the matching line, or -1 on a miss
+ */
+static inline int find_line(cache *sim_cache, size_t base, unsigned long long tag_id, int *empty) {
+    unsigned long long *tags = sim_cache->tags + base;
+    unsigned char *valid = sim_cache->valid + base;
+
+    *empty = -1;
+    for (int i = 0; i < sim_cache->lines_per_set; i++) {
+        if (!valid[i]) {
+            if (*empty < 0) {
+                *empty = i;
+            }
+        } else if (tags[i] == tag_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Points every node of a set's PLRU tree on the path to way away from it. Node n has children 2n and 2n+1, and a
+ * set bit means the pseudo-LRU side is the right-hand one.
+ * @param bits the set's tree
+ * @param way line that was just used
+ * @param lines_per_set associativity, a power of two
+ */
+static inline void plru_touch(unsigned long long *bits, int way, int lines_per_set) {
+    int node = 1;
+    for (int half = lines_per_set / 2; half >= 1; half /= 2) {
+        if (way & half) {
+            *bits &= ~(1ULL << node);
+            node = 2 * node + 1;
+        } else {
+            *bits |= 1ULL << node;
+            node = 2 * node;
+        }
+    }
+}
+
+/**
+ * Follows a set's PLRU tree down to the pseudo-least recently used line.
+ * @param bits the set's tree
+ * @param lines_per_set associativity, a power of two
+ * @return the line to evict
+ */
+static inline int plru_victim(unsigned long long bits, int lines_per_set) {
+    int node = 1;
+    int way = 0;
+    for (int half = lines_per_set / 2; half >= 1; half /= 2) {
+        if (bits & (1ULL << node)) {
+            way |= half;
+            node = 2 * node + 1;
+        } else {
+            node = 2 * node;
+        }
+    }
+    return way;
+}
+
+/**
+ * Records a hit on a line for the replacement policy.
+ * @param sim_cache cache holding the line
+ * @param base index of the set's first line
+ * @param set_id set holding the line
+ * @param way line that was hit
+ */
+static inline void touch_line(cache *sim_cache, size_t base, int set_id, int way) {
+    switch (sim_cache->policy) {
+        case POLICY_LRU:
+            sim_cache->stamps[base + way] = ++sim_cache->clock;
+            break;
+        case POLICY_LFU:
+            sim_cache->stamps[base + way] = ++sim_cache->clock;
+            sim_cache->meta[base + way]++;
+            break;
+        case POLICY_PLRU:
+            plru_touch(&sim_cache->set_state[set_id], way, sim_cache->lines_per_set);
+            break;
+        case POLICY_SRRIP:
+        case POLICY_BRRIP:
+            sim_cache->meta[base + way] = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Picks the line of a full set to replace.
+ * @param sim_cache cache to choose from
+ * @param base index of the set's first line
+ * @param set_id set to choose from
+ * @return the line to evict
+ */
+static int choose_victim(cache *sim_cache, size_t base, int set_id) {
+    int lines_per_set = sim_cache->lines_per_set;
+    unsigned long long *stamps = sim_cache->stamps + base;
+    unsigned int *meta = sim_cache->meta + base;
+    int way = 0;
+
+    switch (sim_cache->policy) {
+        case POLICY_RANDOM:
+            return (int) (next_random(&sim_cache->set_state[set_id]) % lines_per_set);
+        case POLICY_PLRU:
+            return plru_victim(sim_cache->set_state[set_id], lines_per_set);
+        case POLICY_SRRIP:
+        case POLICY_BRRIP:
+            ;
+            //Evict the first line predicted to be re-referenced furthest away, aging the whole set until one
+            //    reaches RRPV_MAX. Adding the gap all at once is the same as repeating the increment.
+            unsigned int oldest = 0;
+            for (int i = 0; i < lines_per_set; i++) {
+                if (meta[i] > oldest) {
+                    oldest = meta[i];
+                    way = i;
+                }
+            }
+            for (int i = 0; i < lines_per_set; i++) {
+                meta[i] += RRPV_MAX - oldest;
+            }
+            return way;
+        default:
+            //LRU, FIFO and LFU, the same comparison scan_stamped makes
+            for (int i = 1; i < lines_per_set; i++) {
+                if (sim_cache->policy == POLICY_LFU && meta[i] != meta[way]) {
+                    if (meta[i] < meta[way]) {
+                        way = i;
+                    }
+                } else if (stamps[i] < stamps[way]) {
+                    way = i;
+                }
+            }
+            return way;
+    }
+}
+
+/**
+ * Installs a tag in a line and gives it the policy's insertion state. The line starts out clean.
+ * @param sim_cache cache holding the line
+ * @param base index of the set's first line
+ * @param set_id set holding the line
+ * @param way line to fill
+ * @param tag_id tag to install
+ */
+static inline void fill_line(cache *sim_cache, size_t base, int set_id, int way, unsigned long long tag_id) {
+    sim_cache->tags[base + way] = tag_id;
+    sim_cache->valid[base + way] = 1;
+    sim_cache->dirty[base + way] = 0;
+    sim_cache->stamps[base + way] = ++sim_cache->clock;
+
+    switch (sim_cache->policy) {
+        case POLICY_LFU:
+            sim_cache->meta[base + way] = 1;
+            break;
+        case POLICY_PLRU:
+            plru_touch(&sim_cache->set_state[set_id], way, sim_cache->lines_per_set);
+            break;
+        case POLICY_SRRIP:
+            sim_cache->meta[base + way] = RRPV_MAX - 1;
+            break;
+        case POLICY_BRRIP:
+            sim_cache->meta[base + way] = (next_random(&sim_cache->set_state[set_id]) & 31) == 0 ? RRPV_MAX - 1
+                                                                                                 : RRPV_MAX;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Random, tree-PLRU, SRRIP and BRRIP: looks the tag up, then lets the policy update its state or pick a victim.
+ * @param sim_cache cache to search through
+ * @param base index of the set's first line
+ * @param set_id set being accessed
+ * @param tag_id tag to look up
+ * @return HIT, COLD_MISS, or MISS
+ */
+static inline enum HitOrMiss scan_stateful(cache *sim_cache, size_t base, int set_id, unsigned long long tag_id) {
+    int empty;
+
+    int way = find_line(sim_cache, base, tag_id, &empty);
+    if (way >= 0) {
+        touch_line(sim_cache, base, set_id, way);
+        return HIT;
+    }
+
+    way = empty >= 0 ? empty : choose_victim(sim_cache, base, set_id);
+    fill_line(sim_cache, base, set_id, way, tag_id);
+
+    return empty >= 0 ? COLD_MISS : MISS;
+}
+
+/**
+ * Looks up the location in the cache and updates it according to the cache's replacement policy. A miss fills the
+ * first empty line in the set if there is one (a cold miss), otherwise the policy picks a line to evict.
+ * @param loc location to search for
+ * @param sim_cache cache to search through
+ * @return HIT, COLD_MISS, or MISS depending on the cache
+ */
+enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
+    size_t base = (size_t) loc->set_id * sim_cache->lines_per_set;
+
+    switch (sim_cache->policy) {
+        case POLICY_LRU:
+            return scan_stamped(sim_cache, base, loc->tag_id, POLICY_LRU);
+        case POLICY_FIFO:
+            return scan_stamped(sim_cache, base, loc->tag_id, POLICY_FIFO);
+        case POLICY_LFU:
+            return scan_stamped(sim_cache, base, loc->tag_id, POLICY_LFU);
+        default:
+            return scan_stateful(sim_cache, base, loc->set_id, loc->tag_id);
+    }
+}
+
+/**
+ * Looks a location up without counting it as a use.
+ * @param sim_cache cache to search through
+ * @param loc location to search for
+ * @return the line within the set holding loc, or -1 if it is not cached
+ */
+int cache_find(cache *sim_cache, location *loc) {
+    int empty;
+    return find_line(sim_cache, (size_t) loc->set_id * sim_cache->lines_per_set, loc->tag_id, &empty);
+}
+
+/**
+ * Records a hit on a line found with cache_find, and marks it dirty if the hit was a write.
+ * @param sim_cache cache holding the line
+ * @param loc location of the line
+ * @param way line within the set
+ * @param write whether the access writes to the line
+ */
+void cache_touch(cache *sim_cache, location *loc, int way, bool write) {
+    size_t base = (size_t) loc->set_id * sim_cache->lines_per_set;
+    touch_line(sim_cache, base, loc->set_id, way);
+    if (write) {
+        sim_cache->dirty[base + way] = 1;
+    }
+}
+
+/**
+ * Brings a location that is not cached into its set, evicting a line chosen by the replacement policy if the set is
+ * full.
+ * @param sim_cache cache to fill
+ * @param loc location to install
+ * @param write whether the line starts out dirty
+ * @param victim filled in with the line that was pushed out, if any
+ * @return COLD_MISS if an empty line was filled, MISS if a line was evicted
+ */
+enum HitOrMiss cache_fill(cache *sim_cache, location *loc, bool write, cache_victim *victim) {
+    size_t base = (size_t) loc->set_id * sim_cache->lines_per_set;
+    int empty;
+
+    find_line(sim_cache, base, loc->tag_id, &empty);
+    victim->evicted = empty < 0;
+    victim->dirty = false;
+
+    int way = empty;
+    if (way < 0) {
+        way = choose_victim(sim_cache, base, loc->set_id);
+        victim->dirty = sim_cache->dirty[base + way];
+        victim->loc.set_id = loc->set_id;
+        victim->loc.tag_id = sim_cache->tags[base + way];
+    }
+    fill_line(sim_cache, base, loc->set_id, way, loc->tag_id);
+    sim_cache->dirty[base + way] = write;
+
+    return victim->evicted ? MISS : COLD_MISS;
+}
+
+/**
+ * Removes a location from the cache, if it is there.
+ * @param sim_cache cache to remove the line from
+ * @param loc location to remove
+ * @param dirty filled in with whether the removed line was dirty
+ * @return whether the location was cached
+ */
+bool cache_invalidate(cache *sim_cache, location *loc, bool *dirty) {
+    size_t base = (size_t) loc->set_id * sim_cache->lines_per_set;
+    int way = cache_find(sim_cache, loc);
+
+    *dirty = false;
+    if (way < 0) {
+        return false;
+    }
+    *dirty = sim_cache->dirty[base + way];
+    sim_cache->valid[base + way] = 0;
+    sim_cache->dirty[base + way] = 0;
+    return true;
+}
+
+/**
+ * Performs one load or store under the cache's write policies and adds the traffic it causes between the cache and
+ * the next level to cp. Hits, misses and evictions are left to the caller, as with cache_scan.
+ * @param sim_cache cache to access
+ * @param loc location being accessed
+ * @param write whether the access is a store
+ * @param size bytes stored, for stores the cache passes straight through
+ * @param cp struct to add the traffic counts to
+ * @param victim filled in with the line that was pushed out, if any
+ * @return HIT, COLD_MISS, or MISS. A store miss that is not allocated is a COLD_MISS, since nothing is evicted.
+ */
+enum HitOrMiss cache_access(cache *sim_cache, location *loc, bool write, int size, cache_performance *cp,
+                            cache_victim *victim) {
+    unsigned long long line_bytes = 1ULL << sim_cache->bytes_per_line;
+    bool keep_dirty = write && sim_cache->write_hit == WRITE_BACK;
+    bool allocate = !write || sim_cache->write_miss == WRITE_ALLOCATE;
+    int way = cache_find(sim_cache, loc);
+
+    //Write-through stores, and store misses that are not allocated, go to the next level right away
+    if (write && (!keep_dirty || (way < 0 && !allocate))) {
+        cp->writebacks++;
+        cp->bytes_written += size;
+    }
+
+    victim->evicted = false;
+    if (way >= 0) {
+        cache_touch(sim_cache, loc, way, keep_dirty);
+        return HIT;
+    }
+    if (!allocate) {
+        return COLD_MISS;
+    }
+
+    enum HitOrMiss result = cache_fill(sim_cache, loc, keep_dirty, victim);
+    cp->bytes_read += line_bytes;
+    if (victim->dirty) {
+        cp->dirty_evictions++;
+        cp->writebacks++;
+        cp->bytes_written += line_bytes;
+    }
+    return result;
+}
+
+/**
+ * Looks up a replacement policy by its -p name.
+ * @param name policy name, e.g. "lru"
+ * @param policy filled in with the matching policy
+ * @return whether the name was recognized
+ */
+bool parse_policy(const char *name, enum ReplacementPolicy *policy) {
+    for (int i = 0; i < (int) (sizeof(policy_names) / sizeof(policy_names[0])); i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            *policy = (enum ReplacementPolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *policy_name(enum ReplacementPolicy policy) {
+    return policy_names[policy];
+}
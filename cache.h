@@ -0,0 +1,163 @@
+/*
+ * cache.h - Flat set/way simulation core used by csim
+ *
+ * Every line of the simulated cache lives in one contiguous block: the tags,
+ * valid bits and LRU stamps of set i occupy indices [i*E, (i+1)*E) of three
+ * parallel arrays, so a lookup touches a handful of adjacent words instead of
+ * chasing per-set linked lists.
+ *
+ * The replacement policy is chosen when the cache is set up. Each policy
+ * keeps only the metadata it needs next to those arrays:
+ *
+ *   lru     stamp of the last use of each line
+ *   fifo    stamp of the fill of each line
+ *   random  a xorshift generator per set
+ *   plru    a binary tree of E-1 direction bits per set (E a power of two, at most 64)
+ *   srrip   a 2-bit re-reference prediction value (RRPV) per line, inserting at 2
+ *   brrip   as srrip, but inserting at 3 except for one fill in 32
+ *   lfu     a use count per line, ties going to the least recently used line
+ *
+ * Lines also carry a dirty bit. cache_scan leaves it alone; the finer
+ * grained cache_find, cache_touch, cache_fill and cache_invalidate calls
+ * track it for callers that model writes and traffic between levels, and
+ * cache_access uses them to apply the cache's write hit policy
+ * (write-back or write-through) and write miss policy (write-allocate or
+ * no-write-allocate).
+ *
+ * Random numbers come from per-set generators seeded from the set index, so
+ * runs are reproducible and do not depend on how sets are split between
+ * threads.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+
+/**
+ * Struct representing a location of data within the cache
+ * @param set_id index of the set
+ * @param tag_id tag of the line
+ */
+typedef struct location {
+    int set_id;
+    unsigned long long tag_id;
+} location;
+
+//Enum representing a cache hit, cold miss, or miss
+enum HitOrMiss {HIT, COLD_MISS, MISS};
+
+//Enums of the write hit and write miss policies
+enum WriteHitPolicy {WRITE_BACK, WRITE_THROUGH};
+enum WriteMissPolicy {WRITE_ALLOCATE, NO_WRITE_ALLOCATE};
+
+//Enum of the supported replacement policies
+enum ReplacementPolicy {POLICY_LRU, POLICY_FIFO, POLICY_RANDOM, POLICY_PLRU, POLICY_SRRIP, POLICY_BRRIP, POLICY_LFU};
+
+/**
+ * Struct describing the line a fill pushed out of its set
+ * @param evicted whether a valid line was replaced
+ * @param dirty whether that line had been written to
+ * @param loc set and tag of that line
+ */
+typedef struct cache_victim {
+    bool evicted;
+    bool dirty;
+    location loc;
+} cache_victim;
+
+/**
+ * Struct to store the performance of the cache. The traffic counters are only filled in by cache_access, and the
+ * miss classes only when the simulator classifies misses, the prefetch counts only when it prefetches, and the victim
+ * counts only when it has a victim or miss cache.
+ * @param hits number of cache hits
+ * @param misses number of cache misses
+ * @param evictions number of cache evictions
+ * @param dirty_evictions number of evictions of dirty lines
+ * @param writebacks number of writes sent to the next level: dirty lines, and stores the cache did not keep
+ * @param bytes_read bytes fetched from the next level
+ * @param bytes_written bytes written to the next level
+ * @param compulsory misses on blocks never referenced before
+ * @param capacity other misses that a fully associative LRU cache of the same size would also have had
+ * @param conflict other misses, which a fully associative LRU cache of the same size would have hit
+ * @param prefetches number of blocks a prefetcher brought into the cache
+ * @param prefetch_hits number of hits that were the first use of a prefetched block
+ * @param useless_prefetches number of prefetched blocks evicted before they were used
+ * @param pollution number of blocks that prefetches evicted, other than prefetched blocks not used yet
+ * @param victim_hits number of misses whose block was in the victim or miss cache
+ * @param victim_swaps number of victim cache hits that swapped the block with a line the cache evicted for it
+ */
+typedef struct cache_performance {
+    int hits;
+    int misses;
+    int evictions;
+    unsigned long long dirty_evictions;
+    unsigned long long writebacks;
+    unsigned long long bytes_read;
+    unsigned long long bytes_written;
+    unsigned long long compulsory;
+    unsigned long long capacity;
+    unsigned long long conflict;
+    unsigned long long prefetches;
+    unsigned long long prefetch_hits;
+    unsigned long long useless_prefetches;
+    unsigned long long pollution;
+    unsigned long long victim_hits;
+    unsigned long long victim_swaps;
+} cache_performance;
+
+/**
+ * Struct representing the cache to be simulated.
+ * @param num_sets number of sets in the cache (2^s)
+ * @param lines_per_set how many lines there are per set (E)
+ * @param bytes_per_line how many bits of the address select the byte within a block (b)
+ * @param sbits number of bits for the set id
+ * @param tbits number of bits for the tag
+ * @param split_lines whether csim splits an access that crosses a block boundary into one access per block
+ * @param tags tag of every line, indexed by set_id * lines_per_set + way
+ * @param stamps value of clock when each line was last touched (filled, for FIFO), the smallest valid stamp in a set
+ *     is the LRU line
+ * @param valid whether each line is caching data
+ * @param dirty whether each line has been written since it was filled
+ * @param clock access counter used to stamp lines
+ * @param policy replacement policy
+ * @param write_hit whether a store hit marks the line dirty (write-back) or goes straight through (write-through)
+ * @param write_miss whether a store miss brings the line in (write-allocate) or only writes the next level
+ * @param set_state one word per set: PLRU tree bits, or the random number generator for random and BRRIP
+ * @param meta one value per line: the RRPV for SRRIP and BRRIP, or the use count for LFU
+ */
+typedef struct cache {
+    int num_sets;
+    int lines_per_set;
+    int bytes_per_line;
+    int sbits;
+    int tbits;
+    bool split_lines;
+    unsigned long long *tags;
+    unsigned long long *stamps;
+    unsigned char *valid;
+    unsigned char *dirty;
+    unsigned long long clock;
+    enum ReplacementPolicy policy;
+    enum WriteHitPolicy write_hit;
+    enum WriteMissPolicy write_miss;
+    unsigned long long *set_state;
+    unsigned int *meta;
+} cache;
+
+void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits,
+                 enum ReplacementPolicy policy);
+void reset_cache(cache *sim_cache);
+void free_cache(cache **sim_cache);
+void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits);
+enum HitOrMiss cache_scan(location *loc, cache *sim_cache);
+int cache_find(cache *sim_cache, location *loc);
+void cache_touch(cache *sim_cache, location *loc, int way, bool write);
+enum HitOrMiss cache_fill(cache *sim_cache, location *loc, bool write, cache_victim *victim);
+bool cache_invalidate(cache *sim_cache, location *loc, bool *dirty);
+enum HitOrMiss cache_access(cache *sim_cache, location *loc, bool write, int size, cache_performance *cp,
+                            cache_victim *victim);
+bool parse_policy(const char *name, enum ReplacementPolicy *policy);
+const char *policy_name(enum ReplacementPolicy policy);
+
+#endif /* CACHE_H */
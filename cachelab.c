@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include "cachelab.h"
 #include <time.h>
 
@@ -74,10 +75,93 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
                            char* desc)
 {
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].inplace_ptr = NULL;
+    func_list[func_counter].kernel_ptr = NULL;
+    func_list[func_counter].reference_ptr = NULL;
+    func_list[func_counter].elem = ELEM_INT;
+    func_list[func_counter].num_operands = 2;
+    func_list[func_counter].operand_rows[0] = 'N';
+    func_list[func_counter].operand_cols[0] = 'M';
+    func_list[func_counter].operand_rows[1] = 'M';
+    func_list[func_counter].operand_cols[1] = 'N';
     func_list[func_counter].description = desc;
+    func_list[func_counter].square_only = 0;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
     func_list[func_counter].num_misses = 0;
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/* 
+ * registerInPlaceTransFunction - Add the given in-place trans function
+ *     into your list of functions to be tested
+ */
+void registerInPlaceTransFunction(void (*trans)(int M, int N, int[N][M]),
+                                  char* desc)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter - 1].inplace_ptr = trans;
+}
+
+/* 
+ * registerSquareInPlaceTransFunction - Add the given in-place trans
+ *     function, which only works when M == N, into your list of
+ *     functions to be tested. It is skipped on other matrix sizes.
+ */
+void registerSquareInPlaceTransFunction(void (*trans)(int M, int N, int[N][M]),
+                                        char* desc)
+{
+    registerInPlaceTransFunction(trans, desc);
+    func_list[func_counter - 1].square_only = 1;
+}
+
+/* 
+ * registerKernelFunction - Add the given generic kernel into your list
+ *     of functions to be tested, with the reference it is checked
+ *     against and the shapes of its operands
+ */
+void registerKernelFunction(kernel_func_t kernel, kernel_func_t reference,
+                            char* desc, enum kernel_elem elem, char* shapes)
+{
+    trans_func_t *f;
+    char* p = shapes;
+    int i;
+
+    registerTransFunction(NULL, desc);
+    f = &func_list[func_counter - 1];
+    f->kernel_ptr = kernel;
+    f->reference_ptr = reference;
+    f->elem = elem;
+
+    /* Parse "RxC,RxC,..." where R and C are each M, N or K */
+    for (i = 0; ; i++) {
+        if (i == MAX_OPERANDS || p[0] == '\0' || !strchr("MNK", p[0]) ||
+            p[1] != 'x' || p[2] == '\0' || !strchr("MNK", p[2]) ||
+            (p[3] != ',' && p[3] != '\0')) {
+            printf("Invalid operand shapes \"%s\" for kernel \"%s\"\n", shapes, desc);
+            exit(1);
+        }
+        f->operand_rows[i] = p[0];
+        f->operand_cols[i] = p[2];
+        if (p[3] == '\0')
+            break;
+        p += 4;
+    }
+    f->num_operands = i + 1;
+}
+
+/* 
+ * kernelElemSize - Returns the size of an element of the given type
+ */
+int kernelElemSize(enum kernel_elem elem)
+{
+    switch (elem) {
+    case ELEM_LONG:
+        return sizeof(long long);
+    case ELEM_DOUBLE:
+        return sizeof(double);
+    default:
+        return sizeof(int);
+    }
+}
@@ -7,9 +7,33 @@
 
 #define MAX_TRANS_FUNCS 100
 
+/* Most operands a generic kernel can take */
+#define MAX_OPERANDS 4
+
+/* Element types of a generic kernel's operands */
+enum kernel_elem {ELEM_INT, ELEM_LONG, ELEM_DOUBLE};
+
+/* A generic kernel. Its operands are matrices whose dimensions are each
+   M, N or K of the problem size, and operands[i] points to the first
+   element of operand i. */
+typedef void (*kernel_func_t)(int M,int N,int K,void* operands[]);
+
+/* A function transposes A into B. If it is in place (inplace_ptr), it
+   transposes the N x M matrix in its one array into the M x N one. If it
+   is a generic kernel (kernel_ptr), it computes its last operand from
+   the others, and is checked against reference_ptr. For the last two,
+   func_ptr is NULL. A square_only function is only run when M == N. */
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  void (*inplace_ptr)(int M,int N,int[N][M]);
+  kernel_func_t kernel_ptr;
+  kernel_func_t reference_ptr;
+  enum kernel_elem elem;
+  int num_operands;
+  char operand_rows[MAX_OPERANDS];  /* 'M', 'N' or 'K' */
+  char operand_cols[MAX_OPERANDS];
   char* description;
+  char square_only;
   char correct;
   unsigned int num_hits;
   unsigned int num_misses;
@@ -27,6 +51,9 @@ void printSummary(int hits,  /* number of  hits */
 /* Fill the matrix with data */
 void initMatrix(int M, int N, int A[N][M], int B[M][N]);
 
+/* Fill a single matrix with random data */
+void randMatrix(int M, int N, int A[N][M]);
+
 /* The baseline trans function that produces correct results. */
 void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 
@@ -34,4 +61,21 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add the given in-place function to the function list */
+void registerInPlaceTransFunction(
+    void (*trans)(int M,int N,int[N][M]), char* desc);
+
+/* Add the given in-place function, which only transposes square
+   matrices, to the function list */
+void registerSquareInPlaceTransFunction(
+    void (*trans)(int M,int N,int[N][M]), char* desc);
+
+/* Add the given generic kernel to the function list. shapes lists the
+   operands' dimensions, such as "NxK,KxM,NxM"; the last is the output. */
+void registerKernelFunction(kernel_func_t kernel, kernel_func_t reference,
+                            char* desc, enum kernel_elem elem, char* shapes);
+
+/* Size in bytes of an element of the given type */
+int kernelElemSize(enum kernel_elem elem);
+
 #endif /* CACHELAB_TOOLS_H */
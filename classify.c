@@ -0,0 +1,205 @@
+/*
+ * classify.c - Compulsory / capacity / conflict (3C) miss classification
+ */
+
+#include "classify.h"
+#include <stdlib.h>
+
+//Slot markers in slot_node
+#define CL_EMPTY (-2)
+#define CL_NOT_RESIDENT (-1)
+
+//Hash slots and nodes a classifier starts out with
+#define CL_INITIAL_HASH 1024
+#define CL_INITIAL_NODES 1024
+
+static inline unsigned int hash_block(unsigned long long block, int hash_size) {
+    return (unsigned int) ((block * 0x9E3779B97F4A7C15ULL) >> 32) & (hash_size - 1);
+}
+
+/**
+ * Allocates an empty classifier.
+ * @param capacity number of lines in the shadow cache, the same as in the cache being classified
+ * @return the new classifier
+ */
+classifier *classifier_create(unsigned long long capacity) {
+    classifier *cl = (classifier *) calloc(1, sizeof(classifier));
+    cl->capacity = capacity;
+
+    cl->hash_size = CL_INITIAL_HASH;
+    cl->keys = (unsigned long long *) malloc(sizeof(unsigned long long) * cl->hash_size);
+    cl->slot_node = (int *) malloc(sizeof(int) * cl->hash_size);
+
+    cl->node_size = CL_INITIAL_NODES;
+    cl->node_block = (unsigned long long *) malloc(sizeof(unsigned long long) * cl->node_size);
+    cl->prev = (int *) malloc(sizeof(int) * cl->node_size);
+    cl->next = (int *) malloc(sizeof(int) * cl->node_size);
+
+    classifier_reset(cl);
+    return cl;
+}
+
+/**
+ * Forgets every block and empties the shadow cache, keeping the memory already allocated.
+ * @param cl classifier to reset
+ */
+void classifier_reset(classifier *cl) {
+    for(int i = 0; i < cl->hash_size; i++) {
+        cl->slot_node[i] = CL_EMPTY;
+    }
+    cl->hash_used = 0;
+    cl->num_nodes = 0;
+    cl->head = -1;
+    cl->tail = -1;
+}
+
+/**
+ * Frees a classifier.
+ * @param cl classifier to free, set to NULL
+ */
+void classifier_free(classifier **cl) {
+    free((*cl)->keys);
+    free((*cl)->slot_node);
+    free((*cl)->node_block);
+    free((*cl)->prev);
+    free((*cl)->next);
+    free(*cl);
+    *cl = NULL;
+}
+
+/**
+ * Finds the slot of a block, or the empty slot where it would go.
+ * @param cl classifier to search
+ * @param block block number
+ * @return the slot
+ */
+static inline int find_slot(classifier *cl, unsigned long long block) {
+    unsigned int slot = hash_block(block, cl->hash_size);
+    while(cl->slot_node[slot] != CL_EMPTY && cl->keys[slot] != block) {
+        slot = (slot + 1) & (cl->hash_size - 1);
+    }
+    return (int) slot;
+}
+
+/**
+ * Doubles the hash table. Nodes record blocks rather than slots, so only the table moves.
+ * @param cl classifier whose table is half full
+ */
+static void grow_hash(classifier *cl) {
+    int old_size = cl->hash_size;
+    unsigned long long *old_keys = cl->keys;
+    int *old_slot_node = cl->slot_node;
+
+    cl->hash_size *= 2;
+    cl->keys = (unsigned long long *) malloc(sizeof(unsigned long long) * cl->hash_size);
+    cl->slot_node = (int *) malloc(sizeof(int) * cl->hash_size);
+    for(int i = 0; i < cl->hash_size; i++) {
+        cl->slot_node[i] = CL_EMPTY;
+    }
+
+    for(int i = 0; i < old_size; i++) {
+        if(old_slot_node[i] == CL_EMPTY) {
+            continue;
+        }
+        int slot = find_slot(cl, old_keys[i]);
+        cl->keys[slot] = old_keys[i];
+        cl->slot_node[slot] = old_slot_node[i];
+    }
+
+    free(old_keys);
+    free(old_slot_node);
+}
+
+/**
+ * Takes a node out of the LRU list.
+ * @param cl classifier owning the list
+ * @param node node to unlink
+ */
+static inline void unlink_node(classifier *cl, int node) {
+    if(cl->prev[node] >= 0) {
+        cl->next[cl->prev[node]] = cl->next[node];
+    } else {
+        cl->head = cl->next[node];
+    }
+    if(cl->next[node] >= 0) {
+        cl->prev[cl->next[node]] = cl->prev[node];
+    } else {
+        cl->tail = cl->prev[node];
+    }
+}
+
+/**
+ * Puts a node at the most recently used end of the LRU list.
+ * @param cl classifier owning the list
+ * @param node node to insert
+ */
+static inline void push_front(classifier *cl, int node) {
+    cl->prev[node] = -1;
+    cl->next[node] = cl->head;
+    if(cl->head >= 0) {
+        cl->prev[cl->head] = node;
+    } else {
+        cl->tail = node;
+    }
+    cl->head = node;
+}
+
+/**
+ * Finds a node for a block entering the shadow cache: a new one while the cache is not full, otherwise the least
+ * recently used node, whose block is marked as no longer resident.
+ * @param cl classifier to take the node from
+ * @return the node, already unlinked from the LRU list
+ */
+static int take_node(classifier *cl) {
+    if((unsigned long long) cl->num_nodes < cl->capacity) {
+        if(cl->num_nodes == cl->node_size) {
+            cl->node_size *= 2;
+            cl->node_block = (unsigned long long *) realloc(cl->node_block, sizeof(unsigned long long) * cl->node_size);
+            cl->prev = (int *) realloc(cl->prev, sizeof(int) * cl->node_size);
+            cl->next = (int *) realloc(cl->next, sizeof(int) * cl->node_size);
+        }
+        return cl->num_nodes++;
+    }
+
+    int node = cl->tail;
+    unlink_node(cl, node);
+    cl->slot_node[find_slot(cl, cl->node_block[node])] = CL_NOT_RESIDENT;
+    return node;
+}
+
+/**
+ * References a block in the shadow cache, bringing it in as the most recently used line.
+ * @param cl classifier to update
+ * @param block block number (address >> b)
+ * @return SHADOW_FIRST if the block was never referenced before, otherwise SHADOW_HIT or SHADOW_MISS for the fully
+ *     associative LRU cache
+ */
+enum ShadowResult classifier_access(classifier *cl, unsigned long long block) {
+    //Keep the table at most half full, so probes stay short
+    if(2 * (cl->hash_used + 1) > cl->hash_size) {
+        grow_hash(cl);
+    }
+
+    int slot = find_slot(cl, block);
+    int node = cl->slot_node[slot];
+    if(node >= 0) {
+        if(node != cl->head) {
+            unlink_node(cl, node);
+            push_front(cl, node);
+        }
+        return SHADOW_HIT;
+    }
+
+    enum ShadowResult result = SHADOW_MISS;
+    if(node == CL_EMPTY) {
+        cl->keys[slot] = block;
+        cl->hash_used++;
+        result = SHADOW_FIRST;
+    }
+
+    node = take_node(cl);
+    cl->node_block[node] = block;
+    cl->slot_node[slot] = node;
+    push_front(cl, node);
+    return result;
+}
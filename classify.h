@@ -0,0 +1,60 @@
+/*
+ * classify.h - Compulsory / capacity / conflict (3C) miss classification
+ *
+ * A miss is compulsory if its block was never referenced before. Otherwise
+ * it is a capacity miss if a fully associative LRU cache with the same
+ * number of lines would have missed too, since no placement could have
+ * kept the block, and a conflict miss if that cache would have hit, since
+ * only the mapping of blocks to sets lost it.
+ *
+ * The classifier is that fully associative shadow cache. A hash table
+ * keyed by block number remembers every block ever referenced, which
+ * answers the first-touch question, and for each one whether and where it
+ * is resident in the shadow. The resident blocks form a doubly linked LRU
+ * list kept in arrays, so a reference costs one expected O(1) hash probe
+ * and a few pointer updates however large the shadow cache is.
+ */
+
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+//Result of a reference to the shadow cache
+enum ShadowResult {SHADOW_HIT, SHADOW_MISS, SHADOW_FIRST};
+
+/**
+ * Struct holding the shadow cache and the blocks seen so far.
+ * @param capacity number of lines in the shadow cache
+ * @param keys block number stored in each hash slot
+ * @param slot_node for each hash slot, the node holding its block, CL_NOT_RESIDENT if the block was seen but is not
+ *     in the shadow cache, or CL_EMPTY for an unused slot
+ * @param hash_size number of hash slots, a power of two
+ * @param hash_used number of occupied slots, which is the number of distinct blocks referenced
+ * @param node_block block held by each node
+ * @param prev next more recently used node, or -1 for the most recently used one
+ * @param next next less recently used node, or -1 for the least recently used one
+ * @param num_nodes number of nodes in use, at most capacity
+ * @param node_size number of nodes allocated
+ * @param head most recently used node, or -1 when the shadow cache is empty
+ * @param tail least recently used node, or -1 when the shadow cache is empty
+ */
+typedef struct classifier {
+    unsigned long long capacity;
+    unsigned long long *keys;
+    int *slot_node;
+    int hash_size;
+    int hash_used;
+    unsigned long long *node_block;
+    int *prev;
+    int *next;
+    int num_nodes;
+    int node_size;
+    int head;
+    int tail;
+} classifier;
+
+classifier *classifier_create(unsigned long long capacity);
+enum ShadowResult classifier_access(classifier *cl, unsigned long long block);
+void classifier_reset(classifier *cl);
+void classifier_free(classifier **cl);
+
+#endif /* CLASSIFY_H */
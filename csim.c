@@ -6,106 +6,29 @@ Patrick Eaton - pweaton@wpi.edu
 */
 
 #include "cachelab.h"
+#include "cache.h"
+#include "trace.h"
+#include "simulator.h"
+#include "stackdist.h"
+#include "parsim.h"
+#include "hierarchy.h"
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
-#include <math.h>
+#include <string.h>
 
-/**
- * Struct representing a location of data within the cache
- * @param set_id index of the set
- * @param tag_id tag of the line
- */
-typedef struct location {
-    int set_id;
-    unsigned long long tag_id;
-} location;
-
-//Enum representing a cache hit, cold miss, or miss
-enum HitOrMiss {HIT, COLD_MISS, MISS};
-
-//Forward declare print_usage and get_and_set_tag
+//Forward declare print_usage
 void print_usage();
-void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits);
-
-/**
- * Struct to store the performance of the cache.
- * @param hits number of cache hits
- * @param misses number of cache misses
- * @param evictions number of cache evictions
- */
-typedef struct cache_performance {
-    int hits;
-    int misses;
-    int evictions;
-} cache_performance;
-
-//Forward declare the simulate_cache function
-void simulate_cache();
-
-/**
- * Struct representing a single line within a set in a cache
- * @param valid whether or not this line is caching data. 0 if the cache hasn't been fully warmed up
- * @param tag number representing the tag for this cache line
- */
-typedef struct line {
-    bool valid;
-    unsigned long long tag; //ensure 64-bit address compatibility
-} line;
 
-/**
- * Struct representing a single set in the simulated cache
- * @param id index of the set in the cache's set array
- * @param lines list of lines within each specific set
- */
-typedef struct set {
-    int id;
-    line *lines;
-} set;
-
-/**
- * Struct for a node in the linked lists managing the LRU eviction policy. Declared before the cache so that it knows
- * the type lru_node.
- * @param prev previous node in the LL
- * @param next subsequent node in the LL
- * @param idx index into the lines array for the set the linked list is responsible for
- */
-typedef struct lru_node {
-    struct lru_node *prev;
-    struct lru_node *next;
-    int idx; //Index into the array of lines in the set
-} lru_node;
-
-/**
- * Struct representing the cache to be simulated.
- * @param sets list of sets the cache will simulate (2^s)
- * @param lines_per_set how many lines there are per set (E)
- * @param bytes_per_line how many bytes each cache block will store (2^b)
- * @param sbits number of bits for the set id
- * @param tbits number of bits for the tag
- * @param verbose unused, was used for printing debugging information originally
- */
-typedef struct cache {
-    set *sets;
-    int lines_per_set;
-    int bytes_per_line;
-    int sbits;
-    int tbits;
-    bool verbose;
-    lru_node **lru_tracker;
-} cache;
-
-//Forward declare of functions requiring cache
-void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits);
-void allocate_cache(cache **sim_cache);
-void allocate_lru_tracker(cache **sim_cache);
-void free_cache(cache **sim_cache);
-enum HitOrMiss cache_scan(struct location *loc, cache *sim_cache);
-void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z);
-void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id);
-void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id);
+//Forward declare the simulation and sweep functions
+void simulate_cache(simulator **sims, int num_sims, trace_reader *trace);
+void print_sweep(geometry *geometries, cache_performance *cps, int num_geometries, bool model_writes, bool classify,
+                 bool prefetch, bool victim);
+void simulate_stack_distance(trace_reader *trace, int s_lo, int s_hi, int bytes_per_line, int max_lines,
+                             bool split_lines);
+void simulate_hierarchy(hierarchy *h, trace_reader *trace, bool split_lines);
 
 /**
  * Called on startup.
@@ -118,22 +41,61 @@ int main(int argc, char *argv[])
     //Initialize all command line parameters
     bool help_flag = false;
     bool verbose_flag = false;
+    bool split_lines = false;
     int s = -1;
     int lines_per_set = -1;
     int bytes_per_line = -1;
     char *trace_path = (char *) NULL;
 
-    FILE *trace_file;
+    //Geometries requested with -g. When there are none, the single -s/-E/-b cache is simulated.
+    geometry *geometries = NULL;
+    int num_geometries = 0;
+
+    //Range of set bits requested with -m for the stack distance analysis
+    bool stack_distance = false;
+    int s_lo = 0;
+    int s_hi = 0;
+
+    //Number of threads to split a single cache's sets across
+    int num_threads = 1;
+
+    //Replacement policy selected with -p
+    enum ReplacementPolicy policy = POLICY_LRU;
+
+    //Write policies selected with -w and -a. Giving either one turns on write traffic modeling and its extra output.
+    enum WriteHitPolicy write_hit = WRITE_BACK;
+    enum WriteMissPolicy write_miss = WRITE_ALLOCATE;
+    bool model_writes = false;
+
+    //Whether -C asked for the misses to be split into compulsory, capacity and conflict misses
+    bool classify = false;
+
+    //Hierarchy config file given with -c
+    char *config_path = (char *) NULL;
+
+    //Prefetcher selected with -P (see prefetch.h)
+    bool prefetch = false;
+    prefetch_config prefetch_cfg;
+
+    //Victim or miss cache selected with -B (see victim.h)
+    bool victim = false;
+    victim_config victim_cfg;
 
-    //Allocate memory for the cache performance struct
-    cache_performance *cp = (cache_performance *) malloc(sizeof(cache_performance));
+    //Binary event log file given with -e (see events.h)
+    char *events_path = (char *) NULL;
+
+    //Regions file given with -r, to break the counts down by (see regions.h)
+    char *regions_path = (char *) NULL;
+
+    trace_reader *trace;
 
     //Declare variables for the current command line argument, and p to pass into strtol
     int opt;
     char *p;
+    const char *range;
 
     //Loop through each command line argument, pull the data into the initialized variables
-    while((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+    while((opt = getopt(argc, argv, "hvxCs:E:b:t:g:m:j:p:c:w:a:r:e:P:B:")) != -1) {
         switch(opt) {
             case 'h':
                 help_flag = true;
@@ -141,6 +103,12 @@ int main(int argc, char *argv[])
             case 'v':
                 verbose_flag = true;
                 break;
+            case 'x':
+                split_lines = true;
+                break;
+            case 'C':
+                classify = true;
+                break;
             case 's':
                 s = strtol(optarg, &p, 10);
                 break;
@@ -153,386 +121,474 @@ int main(int argc, char *argv[])
             case 't':
                 trace_path = optarg;
                 break;
+            case 'c':
+                config_path = optarg;
+                break;
+            case 'r':
+                regions_path = optarg;
+                break;
+            case 'e':
+                events_path = optarg;
+                break;
+            case 'P':
+                prefetch = true;
+                if(!parse_prefetcher(optarg, &prefetch_cfg)) {
+                    printf("Invalid prefetcher \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'B':
+                victim = true;
+                if(!parse_victim_buffer(optarg, &victim_cfg)) {
+                    printf("Invalid victim buffer \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'g':
+                if(!parse_geometries(optarg, &geometries, &num_geometries)) {
+                    printf("Invalid geometry list \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'p':
+                if(!parse_policy(optarg, &policy)) {
+                    printf("Unknown replacement policy \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'w':
+                model_writes = true;
+                if(strcmp(optarg, "back") == 0) {
+                    write_hit = WRITE_BACK;
+                } else if(strcmp(optarg, "through") == 0) {
+                    write_hit = WRITE_THROUGH;
+                } else {
+                    printf("Unknown write hit policy \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'a':
+                model_writes = true;
+                if(strcmp(optarg, "allocate") == 0) {
+                    write_miss = WRITE_ALLOCATE;
+                } else if(strcmp(optarg, "no-allocate") == 0) {
+                    write_miss = NO_WRITE_ALLOCATE;
+                } else {
+                    printf("Unknown write miss policy \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'j':
+                num_threads = strtol(optarg, &p, 10);
+                if(num_threads < 1) {
+                    num_threads = 1;
+                }
+                break;
+            case 'm':
+                stack_distance = true;
+                range = optarg;
+                if(!parse_range(&range, &s_lo, &s_hi) || *range != '\0' || s_lo < 0 || s_hi > 30) {
+                    printf("Invalid set bit range \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
             default:
                 break;
         }
     }
 
-    //If one of the required parameters was not given, so inform user how parameters work then quit
-    if(s == -1 || lines_per_set == -1 || bytes_per_line == -1 || trace_path == (char *) NULL || help_flag) {
-        print_usage();
+    bool sweep = num_geometries > 0;
+
+    //Prefetching only models plain loads and stores into single caches, which -c and -m do not simulate
+    if(prefetch && (model_writes || regions_path != (char *) NULL || config_path != (char *) NULL ||
+                    stack_distance)) {
+        printf("-P cannot be combined with -w, -a, -r, -c or -m.\n");
         exit(0);
     }
 
-    //Open the trace file
-    trace_file = fopen(trace_path, "r");
-
-    //If the trace file doesn't exist, notify and quit
-    if(trace_file == NULL) {
-        printf("Invalid trace file path \"%s\".\n", trace_path);
+    //The victim buffer only models plain loads and stores into a single cache that fills on misses alone
+    if(victim && (model_writes || regions_path != (char *) NULL || prefetch || config_path != (char *) NULL ||
+                  stack_distance)) {
+        printf("-B cannot be combined with -w, -a, -r, -P, -c or -m.\n");
         exit(0);
     }
 
-    //Declare then allocate space needed for the cache
-    cache *simulated_cache = NULL;
-    setup_cache(&simulated_cache, s, lines_per_set, bytes_per_line, 64 - (s + bytes_per_line));
+    //Events are written for one cache only, which a sweep, -c or -m does not simulate
+    if((verbose_flag || events_path != (char *) NULL) && (sweep || config_path != (char *) NULL || stack_distance)) {
+        printf("-v and -e need a single -s/-E/-b cache.\n");
+        exit(0);
+    }
 
-    //Give the verbose flag to the cache to be accessed later
-    simulated_cache->verbose = verbose_flag;
+    //The stack distance analysis covers every E at once, so it only needs b (and optionally the largest E to print)
+    if(stack_distance) {
+        if(bytes_per_line == -1 || trace_path == (char *) NULL || help_flag) {
+            print_usage();
+            exit(0);
+        }
+        if(policy != POLICY_LRU) {
+            printf("Stack distance analysis only models LRU.\n");
+            exit(0);
+        }
+        trace = trace_open(trace_path);
+        if(trace == NULL) {
+            printf("Invalid trace file path \"%s\".\n", trace_path);
+            exit(0);
+        }
+        simulate_stack_distance(trace, s_lo, s_hi, bytes_per_line, lines_per_set, split_lines);
+        trace_close(trace);
+        return 0;
+    }
 
+    //A hierarchy takes its geometries from the config file, so it only needs the trace
+    if(config_path != (char *) NULL) {
+        if(trace_path == (char *) NULL || help_flag) {
+            print_usage();
+            exit(0);
+        }
+        hierarchy *h = hierarchy_load(config_path, policy);
+        if(h == NULL) {
+            exit(0);
+        }
+        trace = trace_open(trace_path);
+        if(trace == NULL) {
+            printf("Invalid trace file path \"%s\".\n", trace_path);
+            exit(0);
+        }
+        simulate_hierarchy(h, trace, split_lines);
+        trace_close(trace);
+        hierarchy_print(h);
+        hierarchy_free(h);
+        return 0;
+    }
 
+    //If one of the required parameters was not given, so inform user how parameters work then quit
+    if((!sweep && (s == -1 || lines_per_set == -1 || bytes_per_line == -1)) || trace_path == (char *) NULL ||
+       help_flag) {
+        print_usage();
+        exit(0);
+    }
 
-    //Run the cache simulation with the trace file input
-    simulate_cache(cp, simulated_cache, trace_file);
+    //Regions are broken down for one cache only
+    region regions[MAX_REGIONS];
+    int num_regions = 0;
+    if(regions_path != (char *) NULL) {
+        if(sweep) {
+            printf("-r needs a single -s/-E/-b cache.\n");
+            exit(0);
+        }
+        if(!regions_load(regions_path, regions, &num_regions)) {
+            printf("Invalid regions file \"%s\".\n", regions_path);
+            exit(0);
+        }
+    }
 
-    printSummary(cp->hits, cp->misses, cp->evictions);
+    //Events are written for one cache only, to stdout for -v or to the -e file
+    event_log *events = NULL;
+    FILE *events_file = NULL;
+    if(verbose_flag || events_path != (char *) NULL) {
+        if(events_path != (char *) NULL) {
+            events_file = fopen(events_path, "wb");
+            if(events_file == NULL) {
+                printf("Unable to create \"%s\".\n", events_path);
+                exit(0);
+            }
+            events = event_log_open(events_file, true);
+        } else {
+            events = event_log_open(stdout, false);
+        }
+    }
 
-    //Free memory allocated for the cache.
-    free_cache(&simulated_cache);
-    free(cp);
+    if(!sweep) {
+        geometries = (geometry *) malloc(sizeof(geometry));
+        geometries[0].s = s;
+        geometries[0].E = lines_per_set;
+        geometries[0].b = bytes_per_line;
+        num_geometries = 1;
+    }
 
-    return 0;
-}
+    //Tree-PLRU needs a full binary tree that fits in one 64-bit word per set
+    if(policy == POLICY_PLRU) {
+        for(int i = 0; i < num_geometries; i++) {
+            int E = geometries[i].E;
+            if(E > 64 || (E & (E - 1)) != 0) {
+                printf("plru needs E to be a power of two no larger than 64 (got %d).\n", E);
+                exit(0);
+            }
+        }
+    }
 
-/**
- * Allocates the entire cache, including sets and lines.
- * @param sim_cache
- * @param sbits
- * @param lines_per_set
- * @param bytes_per_line
- * @param tbits
- */
-void setup_cache(cache **sim_cache, int sbits, int lines_per_set, int bytes_per_line, int tbits) {
-    //Dereference the double pointer to sim_cache, so that we don't have issues with local variable scopes
-    //(see https://stackoverflow.com/questions/3629082/scope-of-malloc-used-in-a-function)
-    *sim_cache = (cache *) malloc(sizeof(cache));
-
-    //Pass along all of the command line arguments
-    (*sim_cache)->sbits = sbits;
-    (*sim_cache)->lines_per_set = lines_per_set;
-    (*sim_cache)->bytes_per_line = bytes_per_line;
-    (*sim_cache)->tbits = 64 - (sbits + bytes_per_line);
-
-    //Allocate space for the sub-structs of the cache
-    allocate_cache(sim_cache);
-}
+    //Open the trace file ("-" reads the trace from stdin)
+    trace = trace_open(trace_path);
 
-void allocate_cache(cache **sim_cache) {
-    //Allocate memory to store the cache and sets
-    (*sim_cache)->sets = (set *) malloc(sizeof(set) * pow(2, (*sim_cache)->sbits));
-
-    //For each set, allocate memory for the lines within
-    for(int i = 0; i < pow(2, (*sim_cache)->sbits); i++) {
-        (*sim_cache)->sets[i].lines = (line *) malloc(sizeof(line) * (*sim_cache)->lines_per_set);
-        (*sim_cache)->sets[i].id = i;
-        for(int j = 0; j < (*sim_cache)->lines_per_set; j++) {
-            //Make sure to initialize validity bits to 0 for each line in each set.
-            (*sim_cache)->sets[i].lines[j].valid = 0;
-        }
+    //If the trace file doesn't exist, notify and quit
+    if(trace == NULL) {
+        printf("Invalid trace file path \"%s\".\n", trace_path);
+        exit(0);
     }
 
-    allocate_lru_tracker(sim_cache);
-}
+    //Allocate one simulator (with every counter starting at 0) per geometry
+    simulator **sims = (simulator **) malloc(sizeof(simulator *) * num_geometries);
+    for(int i = 0; i < num_geometries; i++) {
+        geometry *g = &geometries[i];
+        sims[i] = simulator_create(g->s, g->E, g->b, policy);
+        if(sims[i] == NULL) {
+            printf("Invalid cache geometry s=%d E=%d b=%d.\n", g->s, g->E, g->b);
+            exit(0);
+        }
 
-void allocate_lru_tracker(cache **sim_cache) {
-    //Allocate space for the lru_tracker array, which stored the head sentry nodes of each linked list, corresponding
-    //    to its respective set
-    (*sim_cache)->lru_tracker = (lru_node **) malloc(sizeof(lru_node *) * pow(2, (*sim_cache)->sbits));
-
-    //Set up linked lists with length E for each set
-    for(int i = 0; i < pow(2, (*sim_cache)->sbits); i++) {
-        //Setup the sentry node at the beginning. Allocate space, nullify its previous, then add it to the lru_tracker
-        lru_node *cur_node = (lru_node *) malloc(sizeof(lru_node));
-        cur_node->idx = 0;
-        cur_node->prev = NULL;
-        (*sim_cache)->lru_tracker[i] = cur_node;
-
-        for(int j = 0; j < (*sim_cache)->lines_per_set + 1; j++) {
-            //Add all of the lru nodes to trail after the head sentry node instantiated outside of the j loop. idx is
-            //    j+1, because the sentry node holds idx 0.
-            lru_node *next_node = (lru_node *) malloc(sizeof(lru_node));
-            next_node->idx = j + 1;
-            cur_node->next = next_node;
-            next_node->prev = cur_node;
-
-            //If this is the last iteration through the j loop, this change is permanent (not modified by the next
-            //    iteration), so that the final node is a sentry node with a nullified next pointer.
-            next_node->next = NULL;
-            cur_node = cur_node->next;
+        //Give the event log and write policies to the cache to be accessed later
+        sims[i]->model_writes = model_writes;
+        sims[i]->events = events;
+        sims[i]->sim_cache->split_lines = split_lines;
+        sims[i]->sim_cache->write_hit = write_hit;
+        sims[i]->sim_cache->write_miss = write_miss;
+        if(classify) {
+            simulator_classify(sims[i]);
+        }
+        if(regions_path != (char *) NULL) {
+            simulator_regions(sims[i], regions, num_regions);
+        }
+        if(prefetch) {
+            simulator_prefetch(sims[i], &prefetch_cfg);
+        }
+        if(victim) {
+            simulator_victim(sims[i], &victim_cfg);
         }
     }
-}
 
-void free_cache(cache **sim_cache) {
-    for(int i = 0; i < pow(2, (*sim_cache)->sbits); i++) {
-        free((*sim_cache)->sets[i].lines);
+    //Run the cache simulation with the trace file input. A single cache can have its sets split across threads,
+    //    unless write traffic is being modeled, misses classified, counts broken down by region, blocks prefetched,
+    //    a victim buffer added or events written, which all need the references in order.
+    if(!sweep && num_threads > 1 && !model_writes && !classify && regions_path == (char *) NULL && !prefetch &&
+       !victim && events == NULL) {
+        simulate_cache_parallel(&sims[0]->perf, sims[0]->sim_cache, trace, num_threads);
+    } else {
+        simulate_cache(sims, num_geometries, trace);
+    }
+    trace_close(trace);
+    if(events != NULL) {
+        event_log_free(&events);
+        if(events_file != NULL) {
+            fclose(events_file);
+        }
     }
 
-    free((*sim_cache)->sets);
+    cache_performance *cps = (cache_performance *) malloc(sizeof(cache_performance) * num_geometries);
+    for(int i = 0; i < num_geometries; i++) {
+        simulator_stats(sims[i], &cps[i]);
+    }
 
-    for(int i = 0; i < pow(2, (*sim_cache)->sbits); i++) {
-        lru_node *cur_node = (*sim_cache)->lru_tracker[i];
-        while(cur_node->next != NULL) {
-            cur_node = cur_node->next;
-            free(cur_node->prev);
+    if(sweep) {
+        print_sweep(geometries, cps, num_geometries, model_writes, classify, prefetch, victim);
+    } else {
+        printSummary(cps[0].hits, cps[0].misses, cps[0].evictions);
+        if(model_writes) {
+            printf("dirty_evictions:%llu writebacks:%llu bytes_read:%llu bytes_written:%llu\n",
+                   cps[0].dirty_evictions, cps[0].writebacks, cps[0].bytes_read, cps[0].bytes_written);
+        }
+        if(classify) {
+            printf("compulsory:%llu capacity:%llu conflict:%llu\n", cps[0].compulsory, cps[0].capacity,
+                   cps[0].conflict);
+        }
+        if(prefetch) {
+            printf("prefetches:%llu prefetch_hits:%llu useless_prefetches:%llu pollution:%llu\n", cps[0].prefetches,
+                   cps[0].prefetch_hits, cps[0].useless_prefetches, cps[0].pollution);
+        }
+        if(victim && victim_cfg.kind == VICTIM_CACHE) {
+            printf("victim_hits:%llu victim_swaps:%llu\n", cps[0].victim_hits, cps[0].victim_swaps);
+        } else if(victim) {
+            printf("miss_cache_hits:%llu\n", cps[0].victim_hits);
+        }
+        if(regions_path != (char *) NULL) {
+            region_map_print(sims[0]->regions, classify);
         }
     }
 
-    free((*sim_cache)->lru_tracker);
-    free(*sim_cache);
-}
+    //Free memory allocated for the simulators.
+    for(int i = 0; i < num_geometries; i++) {
+        simulator_free(&sims[i]);
+    }
+    free(sims);
+    free(cps);
+    free(geometries);
 
-/**
- * Separate the tag and set from an address, given s and t to determine set and tag sizes
- * @param loc location struct to fill in with the result
- * @param address location in memory to parse into tag and set
- * @param tbits number of bits the tag takes up
- * @param sbits number of bits the set takes up
- * @return fills in the loc struct with the tag and set id
- */
-void get_set_and_tag(location *loc, unsigned long long address, int tbits, int sbits) {
-    //Shift a block of 1s up to the top of the number, size determined by tbits and sbits
-    unsigned long long tag_mask = ~0 << (64 - tbits);
-    unsigned long long set_mask = ~0 << (64 - sbits);
-
-    //Since the set block comes after tbits, shift the mask back down to line it up
-    set_mask >>= tbits;
-
-    //By &'ing the mask against the address, we get the bits representing the set and tag.
-    //By shifting those back down, we can get the value without 0s between it and the bottom bit.
-    loc->tag_id = (tag_mask & address) >> (64 - tbits);
-    loc->set_id = (set_mask & address) >> ((64 - tbits) - sbits);
+    return 0;
 }
 
 /**
- * Simulates a cache based on trace file output from Valgrind. Counts hits, misses, and evictions.
- * @param cp struct to fill in, specifying hit, miss, and eviction count.
- * @param sim_cache allocated cache to perform operations on
- * @param trace_file file handler for the specified trace file
- * @return fills in the cp variable with the hit, miss, and eviction count
+ * Simulates caches based on trace file output from Valgrind. Counts hits, misses, and evictions. The trace is decoded
+ * once; every batch is run through each of the caches in turn while it is still hot in the CPU's own cache.
+ * @param sims simulators to drive, each adding to its own counts
+ * @param num_sims number of simulators
+ * @param trace open trace to pull references from, one batch at a time
  */
-void simulate_cache(cache_performance *cp, cache *sim_cache, FILE *trace_file) {
-
-    //Allocate (with initialization) the 3 parameters of any trace line
-    char *type = (char *) calloc(sizeof(char), 1);
-    unsigned int *address = (unsigned int *) calloc(sizeof(unsigned int), 1);
-    int *size = (int *) calloc(sizeof(int), 1);
-
-    //Allocate for the location, initialize set and tag id's
-    location *loc = malloc(sizeof(location));
-    loc->set_id = 0;
-    loc->tag_id = 0;
-
-    //Loop through each line in the trace file
-    while(fscanf(trace_file, " %c %x,%d\n", type, address, size) != -1) {
-        get_set_and_tag(loc, *address, sim_cache->tbits, sim_cache->sbits);
-        switch(*type) {
-            case 'M':
-                cp->hits++;
-            case 'S':
-            case 'L':
-                ;
-                //Load instruction. If HIT, increment. If COLD_MISS, pull up new LRU node. If MISS, perform an eviction
-                int result = cache_scan(loc, sim_cache);
-                if(result == HIT) {
-                    cp->hits++;
-                } else if(result == COLD_MISS || result == MISS) {
-                    cp->misses++;
-                    if (result == MISS) {
-                        cp->evictions++;
-                    };
-                }
-                break;
-            case 'I':
-                //Instruction instruction. Pass.
-                break;
-            default:
-                break;
+void simulate_cache(simulator **sims, int num_sims, trace_reader *trace) {
+    trace_ref *refs = (trace_ref *) malloc(sizeof(trace_ref) * TRACE_BATCH);
+    int count;
+
+    //Loop through each batch of decoded references, driving every simulator through the same batch
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        for(int i = 0; i < num_sims; i++) {
+            simulator_feed(sims[i], refs, count);
         }
     }
 
-    free(type);
-    free(address);
-    free(size);
-
-    free(loc);
+    free(refs);
 }
 
 /**
- * Scans the cache for the location provided. Returns whether that line resulted in a cache hit, cold miss, or miss.
- * @param loc location to search for
- * @param sim_cache cache to search through
- * @return HIT, COLD_MISS, or MISS depending on the cache
+ * Prints the results of a sweep, one row per geometry.
+ * @param geometries simulated geometries
+ * @param cps hit, miss, and eviction counts for each geometry
+ * @param num_geometries number of rows
+ * @param model_writes whether to add the write traffic columns
+ * @param classify whether to add the compulsory, capacity and conflict miss columns
+ * @param prefetch whether to add the prefetch columns
+ * @param victim whether to add the victim or miss cache columns
  */
-enum HitOrMiss cache_scan(location *loc, cache *sim_cache) {
-    //Pull out set and tag ids from location
-    int set_id = loc->set_id;
-    unsigned long long tag_id = loc->tag_id;
-
-    //Get the list of lines from the set we want to look at
-    line *lines = sim_cache->sets[set_id].lines;
-
-    bool is_cache_full = true;
-
-    //Loop through the lines in the set
-    for (int i = 0; i < sim_cache->lines_per_set; i++) {
-        //If we have a match, we have a hit. Return.
-        if(lines[i].tag == tag_id && lines[i].valid) {
-            LRU_hit(sim_cache, set_id, tag_id, i);
-            return HIT;
+void print_sweep(geometry *geometries, cache_performance *cps, int num_geometries, bool model_writes, bool classify,
+                 bool prefetch, bool victim) {
+    printf("%4s %4s %4s %10s %12s %12s %12s", "s", "E", "b", "bytes", "hits", "misses", "evictions");
+    if(model_writes) {
+        printf(" %15s %12s %14s %14s", "dirty_evictions", "writebacks", "bytes_read", "bytes_written");
+    }
+    if(classify) {
+        printf(" %12s %12s %12s", "compulsory", "capacity", "conflict");
+    }
+    if(prefetch) {
+        printf(" %12s %13s %18s %12s", "prefetches", "prefetch_hits", "useless_prefetches", "pollution");
+    }
+    if(victim) {
+        printf(" %12s %12s", "victim_hits", "victim_swaps");
+    }
+    printf("\n");
+    for(int i = 0; i < num_geometries; i++) {
+        geometry *g = &geometries[i];
+        unsigned long long bytes = ((unsigned long long) g->E << g->s) << g->b;
+        printf("%4d %4d %4d %10llu %12d %12d %12d", g->s, g->E, g->b, bytes, cps[i].hits, cps[i].misses,
+               cps[i].evictions);
+        if(model_writes) {
+            printf(" %15llu %12llu %14llu %14llu", cps[i].dirty_evictions, cps[i].writebacks, cps[i].bytes_read,
+                   cps[i].bytes_written);
         }
-
-        //If ANY validity bit isn't set, our cache is not empty.
-        if(!lines[i].valid) {
-            is_cache_full = false;
+        if(classify) {
+            printf(" %12llu %12llu %12llu", cps[i].compulsory, cps[i].capacity, cps[i].conflict);
         }
-    }
-
-    //If we don't get a hit and the cache is full, perform an eviction then return. Otherwise, just return.
-    if(is_cache_full) {
-        LRU_miss(sim_cache, set_id, tag_id);
-        return MISS;
-    } else {
-        LRU_cold(sim_cache, set_id, tag_id);
-        return COLD_MISS;
+        if(prefetch) {
+            printf(" %12llu %13llu %18llu %12llu", cps[i].prefetches, cps[i].prefetch_hits, cps[i].useless_prefetches,
+                   cps[i].pollution);
+        }
+        if(victim) {
+            printf(" %12llu %12llu", cps[i].victim_hits, cps[i].victim_swaps);
+        }
+        printf("\n");
     }
 }
 
 /**
- * LRU_hit keeps track of LRU logic in the lru_tracker linked list on a cache hit
- * @param sim_cache makes sure that we still have access to the simulated cache
- * @param set_id the 0-indexed id of the set we are working in
- * @param tag_id the tag_id of whatever is being hit/missed in the cache
- * @param z on a cache hit, z is the position in the lines array of the matching line to the tag id
+ * Runs the LRU stack distance analysis for every set bit count from s_lo to s_hi in a single pass over the trace,
+ * then prints the hits, misses and evictions of each E, in the same layout as a sweep plus the miss ratio.
+ * @param trace open trace to pull references from
+ * @param s_lo smallest number of set bits
+ * @param s_hi largest number of set bits
+ * @param bytes_per_line number of block offset bits
+ * @param max_lines largest E to print, or -1 to print up to the point where the counts stop changing
+ * @param split_lines whether to split accesses that cross a block boundary into one access per block
  */
-void LRU_hit(cache *sim_cache, int set_id, unsigned long long tag_id, int z) {
-    //Grabbing the first real node of the linked list and storing it
-    lru_node *current = sim_cache->lru_tracker[set_id];
-    current = current->next;
-
-    //Grabbing the front sentry node and storing it
-    lru_node *front = sim_cache->lru_tracker[set_id];
-
-    //Progressing through the linked list
-    for (int i = 0; i < sim_cache->lines_per_set; i++) {
-        //Looking for the node that matches the cache hit
-        if (current->idx-1 == z) {
-            //Readjusting the linked list to account for LRU
-            lru_node *previous = current->prev;
-            previous->next = current;
-            lru_node *nextup = current->next;
-            nextup->prev = current;
-            lru_node *hit = current;
-            hit->prev = front;
-
-            //Readjustments that only happen when the cache hit is beyond the first line
-            if(front->next != current) {
-                hit->next = front->next;
-                front->next->prev = hit;
-                previous->next = nextup;
-                nextup->prev = previous;
-            }
-            //Final reordering of linked list
-            front->next = hit;
+void simulate_stack_distance(trace_reader *trace, int s_lo, int s_hi, int bytes_per_line, int max_lines,
+                             bool split_lines) {
+    int num_analyses = s_hi - s_lo + 1;
+    stack_dist **analyses = (stack_dist **) malloc(sizeof(stack_dist *) * num_analyses);
+    for(int i = 0; i < num_analyses; i++) {
+        analyses[i] = stackdist_create(s_lo + i, bytes_per_line);
+    }
 
-            //Set the tag in the linked list to the tag_id and exit the function
-            sim_cache->sets[set_id].lines[current->idx-1].tag = tag_id;
-            return;
-        } else {
-            //Not the cache hit, go to the next node
-            current = current->next;
+    trace_ref *refs = (trace_ref *) malloc(sizeof(trace_ref) * TRACE_BATCH);
+    trace_ref *split = NULL;
+    int split_size = 0;
+    int count;
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        //Every analysis shares b, so a batch only needs splitting once
+        trace_ref *batch = refs;
+        if(split_lines) {
+            count = trace_split_batch(refs, count, bytes_per_line, &split, &split_size);
+            batch = split;
+        }
+        for(int i = 0; i < num_analyses; i++) {
+            stackdist_batch(analyses[i], batch, count);
         }
     }
-}
-
-/**
- * LRU_cold keeps track of LRU logic in the lru_tracker linked list on a cold miss
- * @param sim_cache makes sure that we still have access to the simulated cache
- * @param set_id the 0-indexed id of the set we are working in
- * @param tag_id the tag_id of whatever is being hit/missed in the cache
- */
-void LRU_cold(cache *sim_cache, int set_id, unsigned long long tag_id) {
-    //Grab the first real node of the lru_tracker and store it
-    lru_node *current = sim_cache->lru_tracker[set_id];
-    current = current->next;
-
-    //Grab the front sentry node and store it
-    lru_node *front = sim_cache->lru_tracker[set_id];
-
-    //Loop through the lru_tracker linked list
-    for (int i = 0; i < sim_cache->lines_per_set; i++) {
-        //Looking for an empty line that can be overwritten and set to valid
-        if(!sim_cache->sets[set_id].lines[current->idx-1].valid) {
-            //First round of linked list node readjustment
-            lru_node *previous = current->prev;
-            previous->next = current;
-            lru_node *nextup = current->next;
-            nextup->prev = current;
-            lru_node *empty = current;
-            empty->prev = front;
-
-            //Node readjustment that only happens when the first line isn't the empty one being created
-            if(front->next != current) {
-                empty->next = front->next;
-                front->next->prev = empty;
-                previous->next = nextup;
-                nextup->prev = previous;
-            }
-            //Last readjustment
-            front->next = empty;
-
-            //Set the empty line to the correct tag, set the validity to true, and exit the function
-            sim_cache->sets[set_id].lines[current->idx-1].tag = tag_id;
-            sim_cache->sets[set_id].lines[current->idx-1].valid = true;
-            return;
-        } else {
-            //Not an empty line, go to the next node
-            current = current->next;
+    free(split);
+    free(refs);
+
+    printf("%4s %4s %4s %10s %12s %12s %12s %10s\n", "s", "E", "b", "bytes", "hits", "misses", "evictions",
+           "miss_ratio");
+    for(int i = 0; i < num_analyses; i++) {
+        int last = max_lines > 0 ? max_lines : stackdist_max_lines(analyses[i]);
+        for(int E = 1; E <= last; E++) {
+            unsigned long long hits, misses, evictions;
+            stackdist_counts(analyses[i], E, &hits, &misses, &evictions);
+            unsigned long long bytes = ((unsigned long long) E << (s_lo + i)) << bytes_per_line;
+            printf("%4d %4d %4d %10llu %12llu %12llu %12llu %10.6f\n", s_lo + i, E, bytes_per_line, bytes, hits,
+                   misses, evictions, hits + misses > 0 ? (double) misses / (hits + misses) : 0.0);
         }
+        stackdist_free(analyses[i]);
     }
+    free(analyses);
 }
 
 /**
- * LRU_miss keeps track of LRU logic in the lru_tracker linked list on a cache miss
- * @param sim_cache makes sure the function has access to the simulated cache
- * @param set_id passes in the ID of the set where the miss occurs
- * @param tag_id passes in the tag id that needs to be added to the simulated cache
+ * Runs every reference of the trace through a cache hierarchy, one batch at a time.
+ * @param h hierarchy to simulate, its counts are updated
+ * @param trace open trace to pull references from
+ * @param split_lines whether to split accesses that cross a block boundary into one access per block
  */
-void LRU_miss(cache *sim_cache, int set_id, unsigned long long tag_id) {
-    //Grab the first important node of the lru_tracker linked list and store it
-    lru_node *current = sim_cache->lru_tracker[set_id];
-    current = current->next;
-
-    //Grab the front sentry node and store it
-    lru_node *front = sim_cache->lru_tracker[set_id];
-
-    //Make sure there is more than one line in the set
-    if(sim_cache->lines_per_set > 1) {
-        //If there are multiple lines, there are multiple nodes, so we go to the end of the linked list
-        //The end of the linked list always points to NULL as its next node
-        while(current->next != NULL) {
-            current = current->next;
+void simulate_hierarchy(hierarchy *h, trace_reader *trace, bool split_lines) {
+    trace_ref *refs = (trace_ref *) malloc(sizeof(trace_ref) * TRACE_BATCH);
+    trace_ref *split = NULL;
+    int split_size = 0;
+    int count;
+
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        if(split_lines) {
+            count = trace_split_batch(refs, count, h->block_bits, &split, &split_size);
+            hierarchy_batch(h, split, count);
+        } else {
+            hierarchy_batch(h, refs, count);
         }
-        //We are using sentry nodes, so we back up one to get to the last node that is important
-        //Which means the least recently used line, which will be evicted
-        current = current->prev;
-
-        //Now we shift the second to last node to right after the front sentry node and make sure the linked list is correctly adjusted
-        current->prev->next = current->next;
-        current->next->prev = current->prev;
-        front->next->prev = current;
-        current->next = front->next;
-        current->prev = front;
-        front->next = current;
     }
-    //Regardless of whether or not anything happened to the linked list, we overwrite the tag_id to evict the old data, and exit the function
-    sim_cache->sets[set_id].lines[current->idx-1].tag = tag_id;
-    return;
+
+    free(split);
+    free(refs);
 }
 
 /**
  * Prints the command line usage of the executable. Used if the user did not correctly input parameters.
  */
 void print_usage() {
-    printf("Usage: ./csim [-hv] -s <s> -E <E> -b <b> -t <tracefile>\n");
+    printf("Usage: ./csim [-hvxC] [-p <policy>] [-w <write hit>] [-a <write miss>] [-j <threads>] [-r <regions>] "
+           "[-P <prefetcher>] [-B <victim buffer>] [-e <event log>] -s <s> -E <E> -b <b> -t <tracefile | ->\n");
+    printf("       ./csim [-hvxC] [-p <policy>] [-w <write hit>] [-a <write miss>] [-P <prefetcher>] [-B <victim buffer>] "
+           "-g <s:E:b,...> -t <tracefile | ->\n");
+    printf("       ./csim [-hx] -m <s or lo-hi> [-E <max E>] -b <b> -t <tracefile | ->\n");
+    printf("       ./csim [-hx] [-p <policy>] -c <config> -t <tracefile | ->\n");
+    printf("-P next|stride|stream[:degree[:entries]] prefetches into the cache and adds prefetch hits, useless\n");
+    printf("prefetches and evictions caused by prefetches to the output (see prefetch.h). Not with -w, -a, -r,\n");
+    printf("-c or -m.\n");
+    printf("-B victim|miss[:entries] adds a small fully associative victim cache or miss cache beside the cache and\n");
+    printf("counts the misses it would have served (see victim.h). Not with -w, -a, -r, -P,\n");
+    printf("-c or -m.\n");
+    printf("-v prints every data access and what the cache did, as csim-ref does. -e writes the same events to a\n");
+    printf("binary log instead, which traceconv -x turns into that text.\n");
+    printf("-x splits an access that crosses a block boundary into one access per block it touches.\n");
+    printf("Each s, E and b in a -g geometry may be a number or an inclusive range such as 1-16.\n");
+    printf("-C splits the misses into compulsory, capacity and conflict misses, using a fully associative LRU cache\n");
+    printf("of the same size as a shadow. -j is ignored when it is given.\n");
+    printf("-r breaks the counts down by the address regions in the file (\"name start end\" lines, in hex, as\n");
+    printf("tracegen writes to .regions), and counts which region's lines each region evicted, per set.\n");
+    printf("-m prints the LRU counts of every E for each s in the range from one stack distance pass.\n");
+    printf("-c simulates the L1I/L1D/shared level hierarchy described in the config file (see hierarchy.cfg).\n");
+    printf("-w back|through and -a allocate|no-allocate set the write policies and add dirty evictions, writebacks\n");
+    printf("and bytes moved to and from the next level to the output. -j is ignored when they are given.\n");
+    printf("Policies: lru (default), fifo, random, plru, srrip, brrip, lfu.\n");
 }
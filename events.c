@@ -0,0 +1,157 @@
+/*
+ * events.c - Per-access event stream for csim -v and -e
+ */
+
+#include "events.h"
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Longest text line an event can take: op, 16 hex digits, 10 decimal digits, two outcomes and separators
+#define EVENT_MAX_TEXT 64
+
+//Words csim-ref prints for each outcome, indexed by enum HitOrMiss
+static const char *outcome_words[] = {"hit ", "miss ", "miss eviction "};
+static const int outcome_lengths[] = {4, 5, 14};
+
+/**
+ * Starts an event stream. A binary stream starts with its header.
+ * @param out file to write the events to, which stays open after the log is freed
+ * @param binary whether to write event_records rather than csim-ref's text
+ * @return the log
+ */
+event_log *event_log_open(FILE *out, bool binary) {
+    event_log *log = (event_log *) malloc(sizeof(event_log));
+    log->out = out;
+    log->binary = binary;
+    log->buffer = (char *) malloc(EVENT_BUFFER);
+    log->used = 0;
+
+    if(binary) {
+        unsigned int version = EVENT_VERSION;
+        memcpy(log->buffer, EVENT_MAGIC, 4);
+        memcpy(log->buffer + 4, &version, 4);
+        log->used = 8;
+    }
+    return log;
+}
+
+/**
+ * Formats an event as a line of csim-ref's verbose output, e.g. "M 20,1 miss eviction hit \n".
+ * @param event event to format
+ * @param text filled in with the line, which is not null terminated, at least EVENT_MAX_TEXT bytes
+ * @return the length of the line
+ */
+int event_format(const event_record *event, char *text) {
+    char digits[20];
+    char *p = text;
+    int n = 0;
+
+    *p++ = event->op;
+    *p++ = ' ';
+
+    unsigned long long address = event->address;
+    do {
+        digits[n++] = "0123456789abcdef"[address & 15];
+        address >>= 4;
+    } while(address != 0);
+    while(n > 0) {
+        *p++ = digits[--n];
+    }
+    *p++ = ',';
+
+    unsigned int size = event->size;
+    do {
+        digits[n++] = (char) ('0' + size % 10);
+        size /= 10;
+    } while(size != 0);
+    while(n > 0) {
+        *p++ = digits[--n];
+    }
+    *p++ = ' ';
+
+    for(int i = 0; i < 2 && event->outcome[i] <= MISS; i++) {
+        memcpy(p, outcome_words[event->outcome[i]], outcome_lengths[event->outcome[i]]);
+        p += outcome_lengths[event->outcome[i]];
+    }
+    *p++ = '\n';
+    return (int) (p - text);
+}
+
+/**
+ * Adds one reference and what the cache did to the stream, writing the buffer out first if it is nearly full.
+ * @param log stream to add to
+ * @param op 'L', 'S' or 'M'
+ * @param address address of the reference
+ * @param size number of bytes referenced
+ * @param first HIT, COLD_MISS or MISS for the reference's first access
+ * @param second the same for the store of an M, or EVENT_NONE
+ */
+void event_log_add(event_log *log, char op, unsigned long long address, int size, int first, int second) {
+    if(log->used + EVENT_MAX_TEXT > EVENT_BUFFER) {
+        event_log_flush(log);
+    }
+
+    event_record event;
+    event.address = address;
+    event.size = (unsigned int) size;
+    event.op = op;
+    event.outcome[0] = (unsigned char) first;
+    event.outcome[1] = (unsigned char) second;
+    event.pad = 0;
+
+    if(log->binary) {
+        memcpy(log->buffer + log->used, &event, sizeof(event_record));
+        log->used += sizeof(event_record);
+    } else {
+        log->used += event_format(&event, log->buffer + log->used);
+    }
+}
+
+/**
+ * Writes out every buffered event.
+ * @param log stream to flush
+ */
+void event_log_flush(event_log *log) {
+    fwrite(log->buffer, 1, log->used, log->out);
+    log->used = 0;
+}
+
+/**
+ * Writes out the buffered events and frees the stream, leaving its file open.
+ * @param log stream to free, set to NULL
+ */
+void event_log_free(event_log **log) {
+    event_log_flush(*log);
+    fflush((*log)->out);
+    free((*log)->buffer);
+    free(*log);
+    *log = NULL;
+}
+
+/**
+ * Reads and checks the header of a binary event log.
+ * @param in file positioned at the start of the log
+ * @return whether the file is an event log of this version
+ */
+bool event_read_header(FILE *in) {
+    char header[8];
+    unsigned int version;
+
+    if(fread(header, 1, sizeof(header), in) != sizeof(header) || memcmp(header, EVENT_MAGIC, 4) != 0) {
+        return false;
+    }
+    memcpy(&version, header + 4, 4);
+    return version == EVENT_VERSION;
+}
+
+/**
+ * Reads the next events of a binary event log.
+ * @param in file positioned past the header
+ * @param events filled in with the events
+ * @param max most events to read
+ * @return the number of events read, 0 at the end of the log
+ */
+int event_read(FILE *in, event_record *events, int max) {
+    return (int) fread(events, sizeof(event_record), max, in);
+}
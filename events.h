@@ -0,0 +1,70 @@
+/*
+ * events.h - Per-access event stream for csim -v and -e
+ *
+ * With -v, csim prints every data reference with what the cache did, in
+ * csim-ref's format: "L 10,1 miss eviction ", with one word or pair of
+ * words per access the reference makes ("M 20,1 miss hit "). The lines
+ * are formatted by hand into a large buffer that is written out when it
+ * fills, instead of with one printf each, so a verbose run costs a small
+ * multiple of a quiet one.
+ *
+ * With -e, the same events go to a file as fixed-size binary records,
+ * after an 8-byte header of EVENT_MAGIC and the format version, which is
+ * cheaper still. traceconv -x turns such a log back into csim-ref's text.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define EVENT_MAGIC "CEVT"
+#define EVENT_VERSION 1
+
+//Bytes buffered before the log is written out
+#define EVENT_BUFFER (1 << 20)
+
+//Outcome of the second access of a reference that makes only one
+#define EVENT_NONE 0xff
+
+/**
+ * Struct holding one binary event: a reference and what the cache did.
+ * @param address address of the reference
+ * @param size number of bytes referenced
+ * @param op 'L', 'S' or 'M'
+ * @param outcome HIT, COLD_MISS (a miss) or MISS (a miss with an eviction) for each access of the reference, the
+ *     second being EVENT_NONE unless the reference is an M
+ * @param pad always 0
+ */
+typedef struct event_record {
+    unsigned long long address;
+    unsigned int size;
+    char op;
+    unsigned char outcome[2];
+    unsigned char pad;
+} event_record;
+
+/**
+ * Struct holding an event stream being written.
+ * @param out file the events are written to
+ * @param binary whether the events are written as event_records rather than text
+ * @param buffer events not yet written
+ * @param used number of bytes in the buffer
+ */
+typedef struct event_log {
+    FILE *out;
+    bool binary;
+    char *buffer;
+    size_t used;
+} event_log;
+
+event_log *event_log_open(FILE *out, bool binary);
+void event_log_add(event_log *log, char op, unsigned long long address, int size, int first, int second);
+void event_log_flush(event_log *log);
+void event_log_free(event_log **log);
+int event_format(const event_record *event, char *text);
+bool event_read_header(FILE *in);
+int event_read(FILE *in, event_record *events, int max);
+
+#endif /* EVENTS_H */
@@ -0,0 +1,407 @@
+/*
+ * hierarchy.c - Multi-level cache hierarchy simulation for csim
+ */
+
+#include "hierarchy.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//Names accepted after "inclusion" in a config file, indexed by enum InclusionPolicy
+static const char *inclusion_names[] = {"inclusive", "exclusive", "nine"};
+
+static void send_down(hierarchy *h, int level, unsigned long long block, bool dirty);
+
+/**
+ * Finds the set and tag a block maps to in one level.
+ * @param sim_cache the level's cache
+ * @param block address with the block offset shifted off
+ * @param loc filled in with the block's set and tag
+ */
+static inline void block_location(cache *sim_cache, unsigned long long block, location *loc) {
+    loc->set_id = (int) (block & ((unsigned long long) sim_cache->num_sets - 1));
+    loc->tag_id = block >> sim_cache->sbits;
+}
+
+/**
+ * Rebuilds a block address from the set and tag a level holds it under.
+ * @param sim_cache the level's cache
+ * @param loc set and tag of the block
+ * @return address with the block offset shifted off
+ */
+static inline unsigned long long location_block(cache *sim_cache, location *loc) {
+    return (loc->tag_id << sim_cache->sbits) | (unsigned long long) loc->set_id;
+}
+
+/**
+ * @param h hierarchy
+ * @param level index of a level
+ * @return index of the level below it, or num_levels for memory
+ */
+static inline int level_below(hierarchy *h, int level) {
+    return level < h->first_shared ? h->first_shared : level + 1;
+}
+
+/**
+ * Removes a block from every level above a shared one, for inclusive hierarchies.
+ * @param h hierarchy
+ * @param level shared level that is evicting the block
+ * @param block evicted block
+ * @return whether any of the removed copies was dirty
+ */
+static bool back_invalidate(hierarchy *h, int level, unsigned long long block) {
+    bool any_dirty = false;
+    location loc;
+
+    for(int i = 0; i < level; i++) {
+        bool dirty;
+        block_location(h->levels[i].sim_cache, block, &loc);
+        if(cache_invalidate(h->levels[i].sim_cache, &loc, &dirty)) {
+            h->levels[i].stats.invalidations++;
+            any_dirty = any_dirty || dirty;
+        }
+    }
+    return any_dirty;
+}
+
+/**
+ * Deals with a block a level just evicted: back-invalidates it above for inclusive hierarchies, then sends it to the
+ * level below if it is dirty, or in an exclusive hierarchy, whether or not it is dirty.
+ * @param h hierarchy
+ * @param level level that evicted the block
+ * @param victim the evicted line, as reported by cache_fill
+ */
+static void evict_block(hierarchy *h, int level, cache_victim *victim) {
+    hier_level *lv = &h->levels[level];
+    unsigned long long block = location_block(lv->sim_cache, &victim->loc);
+    bool dirty = victim->dirty;
+
+    lv->stats.evictions++;
+    if(h->inclusion == INCLUSION_INCLUSIVE && level >= h->first_shared) {
+        dirty = back_invalidate(h, level, block) || dirty;
+    }
+
+    if(dirty) {
+        lv->stats.writebacks++;
+    }
+    if(dirty || (h->inclusion == INCLUSION_EXCLUSIVE && level_below(h, level) < h->num_levels)) {
+        send_down(h, level_below(h, level), block, dirty);
+    }
+}
+
+/**
+ * Hands a whole block evicted from the level above to a level. The block is written in full, so a miss allocates it
+ * without reading anything from further down. It is not a demand access, so it counts as a writeback or victim coming
+ * in rather than as a hit or miss.
+ * @param h hierarchy
+ * @param level level receiving the block, or num_levels for memory
+ * @param block the block
+ * @param dirty whether the block carries data memory does not have yet
+ */
+static void send_down(hierarchy *h, int level, unsigned long long block, bool dirty) {
+    if(level >= h->num_levels) {
+        h->memory_writes++;
+        return;
+    }
+
+    hier_level *lv = &h->levels[level];
+    location loc;
+    block_location(lv->sim_cache, block, &loc);
+
+    if(dirty) {
+        lv->stats.writebacks_in++;
+    } else {
+        lv->stats.victims_in++;
+    }
+
+    int way = cache_find(lv->sim_cache, &loc);
+    if(way >= 0) {
+        cache_touch(lv->sim_cache, &loc, way, dirty);
+        return;
+    }
+
+    cache_victim victim;
+    if(cache_fill(lv->sim_cache, &loc, dirty, &victim) == MISS) {
+        evict_block(h, level, &victim);
+    }
+}
+
+/**
+ * Fetches a block for the level above in an exclusive hierarchy: the first level holding it gives it up, and memory
+ * supplies it if none does.
+ * @param h hierarchy
+ * @param level first level to look in, or num_levels for memory
+ * @param block the block
+ * @return whether the block comes up dirty
+ */
+static bool take_block(hierarchy *h, int level, unsigned long long block) {
+    for(; level < h->num_levels; level = level_below(h, level)) {
+        hier_level *lv = &h->levels[level];
+        location loc;
+        bool dirty;
+
+        block_location(lv->sim_cache, block, &loc);
+        if(cache_invalidate(lv->sim_cache, &loc, &dirty)) {
+            lv->stats.hits++;
+            return dirty;
+        }
+        lv->stats.misses++;
+    }
+
+    h->memory_reads++;
+    return false;
+}
+
+/**
+ * Performs a demand read or write of a block at a level, fetching it from below on a miss.
+ * @param h hierarchy
+ * @param level level being accessed, or num_levels for memory
+ * @param block the block
+ * @param write whether the access is a store
+ */
+static void access_level(hierarchy *h, int level, unsigned long long block, bool write) {
+    if(level >= h->num_levels) {
+        h->memory_reads++;
+        return;
+    }
+
+    hier_level *lv = &h->levels[level];
+    location loc;
+    block_location(lv->sim_cache, block, &loc);
+
+    int way = cache_find(lv->sim_cache, &loc);
+    if(way >= 0) {
+        lv->stats.hits++;
+        cache_touch(lv->sim_cache, &loc, way, write);
+        return;
+    }
+
+    lv->stats.misses++;
+    bool dirty = write;
+    if(h->inclusion == INCLUSION_EXCLUSIVE) {
+        dirty = take_block(h, level_below(h, level), block) || dirty;
+    } else {
+        access_level(h, level_below(h, level), block, false);
+    }
+
+    cache_victim victim;
+    if(cache_fill(lv->sim_cache, &loc, dirty, &victim) == MISS) {
+        evict_block(h, level, &victim);
+    }
+}
+
+/**
+ * Runs one batch of decoded references through the hierarchy. Instruction fetches go to L1I and data accesses to
+ * L1D; an M is a load followed by a store.
+ * @param h hierarchy
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+void hierarchy_batch(hierarchy *h, trace_ref *refs, int count) {
+    for(int i = 0; i < count; i++) {
+        unsigned long long block = refs[i].address >> h->block_bits;
+        switch(refs[i].op) {
+            case 'I':
+                if(h->l1i >= 0) {
+                    access_level(h, h->l1i, block, false);
+                }
+                break;
+            case 'L':
+                access_level(h, h->l1d, block, false);
+                break;
+            case 'S':
+                access_level(h, h->l1d, block, true);
+                break;
+            case 'M':
+                access_level(h, h->l1d, block, false);
+                access_level(h, h->l1d, block, true);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Prints one row per level, then the traffic to and from memory.
+ * @param h hierarchy
+ */
+void hierarchy_print(hierarchy *h) {
+    printf("inclusion: %s\n", inclusion_names[h->inclusion]);
+    printf("%-6s %4s %4s %4s %-6s %12s %12s %12s %12s %13s %13s %12s\n", "level", "s", "E", "b", "policy", "hits",
+           "misses", "evictions", "writebacks", "invalidations", "writebacks_in", "victims_in");
+    for(int i = 0; i < h->num_levels; i++) {
+        hier_level *lv = &h->levels[i];
+        cache *c = lv->sim_cache;
+        printf("%-6s %4d %4d %4d %-6s %12llu %12llu %12llu %12llu %13llu %13llu %12llu\n", lv->name, c->sbits,
+               c->lines_per_set, c->bytes_per_line, policy_name(c->policy), lv->stats.hits, lv->stats.misses,
+               lv->stats.evictions, lv->stats.writebacks, lv->stats.invalidations, lv->stats.writebacks_in,
+               lv->stats.victims_in);
+    }
+    printf("memory reads: %llu (%llu bytes) writes: %llu (%llu bytes)\n", h->memory_reads,
+           h->memory_reads << h->block_bits, h->memory_writes, h->memory_writes << h->block_bits);
+}
+
+/**
+ * Reads a hierarchy description and allocates its caches. Problems are reported with their line number.
+ * @param path config file to read
+ * @param default_policy replacement policy for levels that do not name one
+ * @return the new hierarchy, or NULL if the file could not be read or is invalid
+ */
+hierarchy *hierarchy_load(const char *path, enum ReplacementPolicy default_policy) {
+    FILE *config = fopen(path, "r");
+    if(config == NULL) {
+        printf("Invalid hierarchy config path \"%s\".\n", path);
+        return NULL;
+    }
+
+    //Private and shared levels are collected separately, then laid out private first
+    hier_level private_levels[2];
+    hier_level shared_levels[HIERARCHY_MAX_LEVELS];
+    int geometry[HIERARCHY_MAX_LEVELS + 2][3];
+    enum ReplacementPolicy policies[HIERARCHY_MAX_LEVELS + 2];
+    bool have_private[2] = {false, false};
+    int num_shared = 0;
+    enum InclusionPolicy inclusion = INCLUSION_INCLUSIVE;
+    int block_bits = -1;
+
+    char line[256];
+    int line_no = 0;
+    bool ok = true;
+
+    while(ok && fgets(line, sizeof(line), config) != NULL) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if(comment != NULL) {
+            *comment = '\0';
+        }
+
+        char name[32], extra[32];
+        int s, E, b;
+        char policy_buf[32] = "";
+        int fields = sscanf(line, "%31s %d %d %d %31s %31s", name, &s, &E, &b, policy_buf, extra);
+        if(fields <= 0) {
+            continue;
+        }
+
+        if(strcmp(name, "inclusion") == 0) {
+            //The inclusion line has a single word, which the numeric conversion above stopped at
+            ok = false;
+            if(sscanf(line, "%*s %31s %31s", policy_buf, extra) == 1) {
+                for(int i = 0; i < (int) (sizeof(inclusion_names) / sizeof(inclusion_names[0])); i++) {
+                    if(strcmp(policy_buf, inclusion_names[i]) == 0) {
+                        inclusion = (enum InclusionPolicy) i;
+                        ok = true;
+                    }
+                }
+            }
+            if(!ok) {
+                printf("%s:%d: expected \"inclusion inclusive|exclusive|nine\".\n", path, line_no);
+            }
+            continue;
+        }
+
+        if(fields < 4 || fields > 5 || strlen(name) >= sizeof(shared_levels[0].name)) {
+            printf("%s:%d: expected \"<name> <s> <E> <b> [policy]\".\n", path, line_no);
+            ok = false;
+            break;
+        }
+
+        enum ReplacementPolicy policy = default_policy;
+        if(fields == 5 && !parse_policy(policy_buf, &policy)) {
+            printf("%s:%d: unknown replacement policy \"%s\".\n", path, line_no, policy_buf);
+            ok = false;
+            break;
+        }
+
+        //Every level needs at least one line and room for a tag, and all of them move whole blocks of one size
+        if(s < 0 || E < 1 || b < 0 || s + b >= 64 || s > 30) {
+            printf("%s:%d: invalid geometry.\n", path, line_no);
+            ok = false;
+            break;
+        }
+        if(block_bits >= 0 && b != block_bits) {
+            printf("%s:%d: every level must use the same b.\n", path, line_no);
+            ok = false;
+            break;
+        }
+        if(policy == POLICY_PLRU && (E > 64 || (E & (E - 1)) != 0)) {
+            printf("%s:%d: plru needs E to be a power of two no larger than 64.\n", path, line_no);
+            ok = false;
+            break;
+        }
+        block_bits = b;
+
+        hier_level *lv;
+        int slot;
+        if(strcmp(name, "L1I") == 0 || strcmp(name, "L1D") == 0) {
+            int which = name[2] == 'D';
+            if(have_private[which]) {
+                printf("%s:%d: %s is listed twice.\n", path, line_no, name);
+                ok = false;
+                break;
+            }
+            have_private[which] = true;
+            lv = &private_levels[which];
+            slot = which;
+        } else {
+            if(num_shared == HIERARCHY_MAX_LEVELS - 2) {
+                printf("%s:%d: too many levels.\n", path, line_no);
+                ok = false;
+                break;
+            }
+            lv = &shared_levels[num_shared];
+            slot = 2 + num_shared++;
+        }
+        strcpy(lv->name, name);
+        geometry[slot][0] = s;
+        geometry[slot][1] = E;
+        geometry[slot][2] = b;
+        policies[slot] = policy;
+    }
+    fclose(config);
+
+    if(ok && !have_private[1]) {
+        printf("%s: the hierarchy needs an L1D level.\n", path);
+        ok = false;
+    }
+    if(!ok) {
+        return NULL;
+    }
+
+    hierarchy *h = (hierarchy *) calloc(1, sizeof(hierarchy));
+    h->inclusion = inclusion;
+    h->block_bits = block_bits;
+    h->l1i = -1;
+
+    //Lay the levels out as L1I, L1D, then the shared levels in file order
+    for(int slot = 0; slot < 2 + num_shared; slot++) {
+        if(slot < 2 && !have_private[slot]) {
+            continue;
+        }
+        hier_level *lv = &h->levels[h->num_levels];
+        *lv = slot < 2 ? private_levels[slot] : shared_levels[slot - 2];
+        memset(&lv->stats, 0, sizeof(level_stats));
+
+        int s = geometry[slot][0];
+        int b = geometry[slot][2];
+        setup_cache(&lv->sim_cache, s, geometry[slot][1], b, 64 - (s + b), policies[slot]);
+
+        if(slot == 0) {
+            h->l1i = h->num_levels;
+        } else if(slot == 1) {
+            h->l1d = h->num_levels;
+        }
+        h->num_levels++;
+    }
+    h->first_shared = h->l1d + 1;
+
+    return h;
+}
+
+void hierarchy_free(hierarchy *h) {
+    for(int i = 0; i < h->num_levels; i++) {
+        free_cache(&h->levels[i].sim_cache);
+    }
+    free(h);
+}
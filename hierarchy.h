@@ -0,0 +1,106 @@
+/*
+ * hierarchy.h - Multi-level cache hierarchy simulation for csim
+ *
+ * A hierarchy is read from a config file with one level per line, first
+ * level first:
+ *
+ *   # name  s  E  b  [policy]
+ *   L1I     6  8  6
+ *   L1D     6  8  6
+ *   L2      9  8  6
+ *   LLC     12 16 6  srrip
+ *   inclusion inclusive
+ *
+ * Instruction fetches go to the level named L1I and data accesses to the
+ * level named L1D; a missing L1I means instruction fetches are skipped, as
+ * in single-cache mode. Every other level is shared and sits below both, in
+ * file order, with memory below the last one. All levels share one block
+ * size, so a block moves between levels as a whole.
+ *
+ * Lines are written back and allocated on writes. The inclusion policy
+ * decides how the levels relate:
+ *
+ *   inclusive  a block in an upper level is also in every shared level
+ *              below it; a shared level evicting a block back-invalidates
+ *              it above
+ *   exclusive  a block lives in one level at a time; a hit below moves the
+ *              block up, and every block an upper level evicts moves down
+ *   nine       non-inclusive non-exclusive: misses fill every level on the
+ *              way up and evictions leave the other levels alone
+ */
+
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include "cache.h"
+#include "trace.h"
+
+/* Most levels a config file may describe */
+#define HIERARCHY_MAX_LEVELS 8
+
+//Enum of the supported inclusion policies
+enum InclusionPolicy {INCLUSION_INCLUSIVE, INCLUSION_EXCLUSIVE, INCLUSION_NINE};
+
+/**
+ * Struct counting what happened at one level. Hits and misses count demand accesses only: blocks the level above
+ * evicts into it are counted on their own, whether or not the level already held them.
+ * @param hits number of demand accesses that found their block
+ * @param misses number of demand accesses that did not
+ * @param evictions number of valid blocks replaced
+ * @param writebacks number of dirty blocks written to the level below (or memory)
+ * @param invalidations number of blocks removed by a back-invalidation from below
+ * @param writebacks_in number of dirty blocks written back into the level from the level above
+ * @param victims_in number of clean blocks the level above evicted into it, in an exclusive hierarchy
+ */
+typedef struct level_stats {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long writebacks;
+    unsigned long long invalidations;
+    unsigned long long writebacks_in;
+    unsigned long long victims_in;
+} level_stats;
+
+/**
+ * Struct holding one level of the hierarchy
+ * @param name level name from the config file
+ * @param sim_cache the level's cache
+ * @param stats the level's counts
+ */
+typedef struct hier_level {
+    char name[16];
+    cache *sim_cache;
+    level_stats stats;
+} hier_level;
+
+/**
+ * Struct representing a whole hierarchy
+ * @param levels every level, L1I and L1D (when present) first, then the shared levels in order
+ * @param num_levels number of levels
+ * @param first_shared index of the first shared level
+ * @param l1i index of L1I, or -1 if there is none
+ * @param l1d index of L1D
+ * @param block_bits block offset bits shared by every level (b)
+ * @param inclusion inclusion policy
+ * @param memory_reads blocks read from memory
+ * @param memory_writes blocks written to memory
+ */
+typedef struct hierarchy {
+    hier_level levels[HIERARCHY_MAX_LEVELS];
+    int num_levels;
+    int first_shared;
+    int l1i;
+    int l1d;
+    int block_bits;
+    enum InclusionPolicy inclusion;
+    unsigned long long memory_reads;
+    unsigned long long memory_writes;
+} hierarchy;
+
+hierarchy *hierarchy_load(const char *path, enum ReplacementPolicy default_policy);
+void hierarchy_batch(hierarchy *h, trace_ref *refs, int count);
+void hierarchy_print(hierarchy *h);
+void hierarchy_free(hierarchy *h);
+
+#endif /* HIERARCHY_H */
@@ -0,0 +1,218 @@
+/*
+ * kernels.c - Kernels other than int transposes, for the same evaluation
+ *
+ * Each kernel is registered with registerKernelFunction, along with the
+ * shapes of its operands and a plain reference it is checked against,
+ * and test-trans -k evaluates it like a transpose. A kernel takes the
+ * problem size M, N and K and an array of pointers to its operands,
+ * which it views as matrices of the right shape.
+ *
+ * With 8-byte elements a 32-byte line holds 4 elements instead of 8, so
+ * the blocking that suits int transposes is twice too wide here.
+ */
+#include <stdio.h>
+#include "cachelab.h"
+
+//Side of the blocks the blocked kernels work on: one line of 8-byte elements in the lab's cache
+#define KERNEL_BLOCK 4
+
+/*
+ * transpose_long_reference - Transposes the N x M matrix of long longs A into B
+ */
+static void transpose_long_reference(int M, int N, int K, void *operands[])
+{
+    long long (*A)[M] = operands[0];
+    long long (*B)[N] = operands[1];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+ * trans_long - A simple row-wise scan transpose of long longs
+ */
+char trans_long_desc[] = "Simple row-wise scan transpose (long long)";
+void trans_long(int M, int N, int K, void *operands[])
+{
+    long long (*A)[M] = operands[0];
+    long long (*B)[N] = operands[1];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+ * transpose_long_blocked - Transposes long longs in KERNEL_BLOCK square blocks, so that each line of A and of B in
+ *     a block is used whole while it is in the cache
+ */
+char transpose_long_blocked_desc[] = "4x4 blocked transpose (long long)";
+void transpose_long_blocked(int M, int N, int K, void *operands[])
+{
+    long long (*A)[M] = operands[0];
+    long long (*B)[N] = operands[1];
+
+    for(int block_row = 0; block_row < N; block_row += KERNEL_BLOCK) {
+        for(int block_col = 0; block_col < M; block_col += KERNEL_BLOCK) {
+            for(int i = block_row; i < block_row + KERNEL_BLOCK && i < N; i++) {
+                for(int j = block_col; j < block_col + KERNEL_BLOCK && j < M; j++) {
+                    B[j][i] = A[i][j];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * transpose_double_reference - Transposes the N x M matrix of doubles A into B
+ */
+static void transpose_double_reference(int M, int N, int K, void *operands[])
+{
+    double (*A)[M] = operands[0];
+    double (*B)[N] = operands[1];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+ * transpose_double_blocked - Transposes doubles in KERNEL_BLOCK square blocks
+ */
+char transpose_double_blocked_desc[] = "4x4 blocked transpose (double)";
+void transpose_double_blocked(int M, int N, int K, void *operands[])
+{
+    double (*A)[M] = operands[0];
+    double (*B)[N] = operands[1];
+
+    for(int block_row = 0; block_row < N; block_row += KERNEL_BLOCK) {
+        for(int block_col = 0; block_col < M; block_col += KERNEL_BLOCK) {
+            for(int i = block_row; i < block_row + KERNEL_BLOCK && i < N; i++) {
+                for(int j = block_col; j < block_col + KERNEL_BLOCK && j < M; j++) {
+                    B[j][i] = A[i][j];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * dgemm_reference - C = A B, with A N x K, B K x M and C N x M
+ */
+static void dgemm_reference(int M, int N, int K, void *operands[])
+{
+    double (*A)[K] = operands[0];
+    double (*B)[M] = operands[1];
+    double (*C)[M] = operands[2];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            double sum = 0;
+            for(int k = 0; k < K; k++) {
+                sum += A[i][k] * B[k][j];
+            }
+            C[i][j] = sum;
+        }
+    }
+}
+
+/*
+ * dgemm_ijk - Textbook matrix multiply: each element of C is the dot product of a row of A and a column of B, so B
+ *     is read down its columns, one line per element
+ */
+char dgemm_ijk_desc[] = "Textbook ijk matrix multiply (double)";
+void dgemm_ijk(int M, int N, int K, void *operands[])
+{
+    double (*A)[K] = operands[0];
+    double (*B)[M] = operands[1];
+    double (*C)[M] = operands[2];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            double sum = 0;
+            for(int k = 0; k < K; k++) {
+                sum += A[i][k] * B[k][j];
+            }
+            C[i][j] = sum;
+        }
+    }
+}
+
+/*
+ * dgemm_ikj - Matrix multiply with the j and k loops swapped, so that the inner loop runs along rows of B and C
+ */
+char dgemm_ikj_desc[] = "Loop-interchanged ikj matrix multiply (double)";
+void dgemm_ikj(int M, int N, int K, void *operands[])
+{
+    double (*A)[K] = operands[0];
+    double (*B)[M] = operands[1];
+    double (*C)[M] = operands[2];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            C[i][j] = 0;
+        }
+        for(int k = 0; k < K; k++) {
+            double a = A[i][k];
+            for(int j = 0; j < M; j++) {
+                C[i][j] += a * B[k][j];
+            }
+        }
+    }
+}
+
+/*
+ * dgemm_blocked - Matrix multiply in KERNEL_BLOCK square tiles of A, B and C. A tile of each is one line per row,
+ *     so the three tiles stay in the cache while the tile of C is updated from a tile of A and one of B.
+ */
+char dgemm_blocked_desc[] = "4x4 tiled matrix multiply (double)";
+void dgemm_blocked(int M, int N, int K, void *operands[])
+{
+    double (*A)[K] = operands[0];
+    double (*B)[M] = operands[1];
+    double (*C)[M] = operands[2];
+
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            C[i][j] = 0;
+        }
+    }
+
+    for(int block_i = 0; block_i < N; block_i += KERNEL_BLOCK) {
+        for(int block_j = 0; block_j < M; block_j += KERNEL_BLOCK) {
+            for(int block_k = 0; block_k < K; block_k += KERNEL_BLOCK) {
+                for(int i = block_i; i < block_i + KERNEL_BLOCK && i < N; i++) {
+                    for(int k = block_k; k < block_k + KERNEL_BLOCK && k < K; k++) {
+                        double a = A[i][k];
+                        for(int j = block_j; j < block_j + KERNEL_BLOCK && j < M; j++) {
+                            C[i][j] += a * B[k][j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * registerKernels - Registers the kernels above with the driver. test-trans
+ *     and tracegen call it when given -k, after registerFunctions.
+ */
+void registerKernels()
+{
+    registerKernelFunction(trans_long, transpose_long_reference, trans_long_desc, ELEM_LONG, "NxM,MxN");
+    registerKernelFunction(transpose_long_blocked, transpose_long_reference, transpose_long_blocked_desc, ELEM_LONG,
+                           "NxM,MxN");
+    registerKernelFunction(transpose_double_blocked, transpose_double_reference, transpose_double_blocked_desc,
+                           ELEM_DOUBLE, "NxM,MxN");
+    registerKernelFunction(dgemm_ijk, dgemm_reference, dgemm_ijk_desc, ELEM_DOUBLE, "NxK,KxM,NxM");
+    registerKernelFunction(dgemm_ikj, dgemm_reference, dgemm_ikj_desc, ELEM_DOUBLE, "NxK,KxM,NxM");
+    registerKernelFunction(dgemm_blocked, dgemm_reference, dgemm_blocked_desc, ELEM_DOUBLE, "NxK,KxM,NxM");
+}
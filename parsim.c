@@ -0,0 +1,205 @@
+/*
+ * parsim.c - Set-partitioned multi-threaded simulation for csim
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "parsim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Entries in each shard's ring buffer, a power of two */
+#define RING_SIZE (1 << 14)
+
+/* The producer makes its writes visible to a worker every this many references, and at the end of every batch */
+#define PUBLISH_CHUNK 256
+
+/**
+ * Struct for one routed reference
+ * @param tag_id tag of the referenced line
+ * @param set_id set of the referenced line
+ * @param modify whether the reference was an M, whose store half is an extra hit
+ */
+typedef struct shard_ref {
+    unsigned long long tag_id;
+    int set_id;
+    int modify;
+} shard_ref;
+
+/**
+ * Struct holding one worker's share of the simulation. head and tail sit on their own cache lines so the producer
+ * and the worker do not keep stealing each other's line.
+ * @param ring references waiting to be simulated
+ * @param tail number of references the producer has published
+ * @param head number of references the worker has finished with
+ * @param done set by the producer once the trace is exhausted and tail is final
+ * @param local_tail number of references written, including ones not yet published (producer only)
+ * @param cached_head last value of head the producer saw (producer only)
+ * @param view shallow copy of the cache with its own LRU clock. Only the sets owned by this shard are touched through
+ *     it, and LRU only compares stamps within one set, so a private clock is enough.
+ * @param cp this shard's counts, merged once the worker exits
+ * @param thread worker thread
+ */
+typedef struct shard {
+    shard_ref *ring;
+    unsigned long tail __attribute__((aligned(64)));
+    unsigned long head __attribute__((aligned(64)));
+    int done;
+    unsigned long local_tail __attribute__((aligned(64)));
+    unsigned long cached_head;
+    cache view;
+    cache_performance cp;
+    pthread_t thread;
+} shard;
+
+/**
+ * Worker loop: drains the shard's ring until the producer is done and nothing is left.
+ * @param arg the shard to simulate
+ * @return NULL
+ */
+static void *shard_worker(void *arg) {
+    shard *sh = (shard *) arg;
+    unsigned long head = sh->head;
+    location loc;
+
+    while(true) {
+        unsigned long tail = __atomic_load_n(&sh->tail, __ATOMIC_ACQUIRE);
+        if(head == tail) {
+            //done is only set after the final publish, so re-read tail before giving up
+            if(__atomic_load_n(&sh->done, __ATOMIC_ACQUIRE) && head == __atomic_load_n(&sh->tail, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        for(; head != tail; head++) {
+            shard_ref *ref = &sh->ring[head & (RING_SIZE - 1)];
+            loc.set_id = ref->set_id;
+            loc.tag_id = ref->tag_id;
+            sh->cp.hits += ref->modify;
+
+            int result = cache_scan(&loc, &sh->view);
+            if(result == HIT) {
+                sh->cp.hits++;
+            } else {
+                sh->cp.misses++;
+                if(result == MISS) {
+                    sh->cp.evictions++;
+                }
+            }
+        }
+        __atomic_store_n(&sh->head, head, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/**
+ * Makes everything the producer has written to a shard visible to its worker.
+ * @param sh shard to publish
+ */
+static inline void shard_publish(shard *sh) {
+    __atomic_store_n(&sh->tail, sh->local_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Appends a reference to a shard's ring, waiting for the worker if the ring is full.
+ * @param sh shard to append to
+ * @param loc set and tag of the reference
+ * @param modify whether the reference was an M
+ */
+static inline void shard_push(shard *sh, location *loc, int modify) {
+    if(sh->local_tail - sh->cached_head == RING_SIZE) {
+        shard_publish(sh);
+        while((sh->cached_head = __atomic_load_n(&sh->head, __ATOMIC_ACQUIRE)) + RING_SIZE == sh->local_tail) {
+            sched_yield();
+        }
+    }
+
+    shard_ref *ref = &sh->ring[sh->local_tail & (RING_SIZE - 1)];
+    ref->tag_id = loc->tag_id;
+    ref->set_id = loc->set_id;
+    ref->modify = modify;
+    sh->local_tail++;
+
+    if((sh->local_tail & (PUBLISH_CHUNK - 1)) == 0) {
+        shard_publish(sh);
+    }
+}
+
+/**
+ * Simulates a cache with its sets split across worker threads. The calling thread decodes the trace and routes
+ * references; each worker owns a contiguous range of sets so that neighbouring sets' lines, which share CPU cache
+ * lines, stay on one thread.
+ * @param cp struct to fill in, specifying hit, miss, and eviction count
+ * @param sim_cache allocated cache to perform operations on
+ * @param trace open trace to pull references from, one batch at a time
+ * @param num_threads number of worker threads, capped at the number of sets
+ * @return fills in the cp variable with the hit, miss, and eviction count
+ */
+void simulate_cache_parallel(cache_performance *cp, cache *sim_cache, trace_reader *trace, int num_threads) {
+    if(num_threads > sim_cache->num_sets) {
+        num_threads = sim_cache->num_sets;
+    }
+    int sets_per_shard = (sim_cache->num_sets + num_threads - 1) / num_threads;
+
+    shard *shards;
+    if(posix_memalign((void **) &shards, 64, sizeof(shard) * num_threads) != 0) {
+        return;
+    }
+    memset(shards, 0, sizeof(shard) * num_threads);
+
+    for(int i = 0; i < num_threads; i++) {
+        shards[i].ring = (shard_ref *) malloc(sizeof(shard_ref) * RING_SIZE);
+        shards[i].view = *sim_cache;
+        pthread_create(&shards[i].thread, NULL, shard_worker, &shards[i]);
+    }
+
+    trace_ref *refs = (trace_ref *) malloc(sizeof(trace_ref) * TRACE_BATCH);
+    location loc;
+    int count;
+
+    //Buffer for the batch with accesses split at block boundaries, if the cache splits them
+    trace_ref *split = NULL;
+    int split_size = 0;
+
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        trace_ref *batch = refs;
+        if(sim_cache->split_lines) {
+            count = trace_split_batch(refs, count, sim_cache->bytes_per_line, &split, &split_size);
+            batch = split;
+        }
+
+        for(int i = 0; i < count; i++) {
+            char op = batch[i].op;
+            if(op != 'L' && op != 'S' && op != 'M') {
+                continue;
+            }
+            get_set_and_tag(&loc, batch[i].address, sim_cache->tbits, sim_cache->sbits);
+            shard_push(&shards[loc.set_id / sets_per_shard], &loc, op == 'M');
+        }
+
+        //Don't leave a partial chunk sitting unpublished while the next batch is decoded
+        for(int i = 0; i < num_threads; i++) {
+            shard_publish(&shards[i]);
+        }
+    }
+    free(split);
+    free(refs);
+
+    //Signal the end of the trace and merge each worker's counts as it finishes
+    for(int i = 0; i < num_threads; i++) {
+        __atomic_store_n(&shards[i].done, 1, __ATOMIC_RELEASE);
+    }
+    for(int i = 0; i < num_threads; i++) {
+        pthread_join(shards[i].thread, NULL);
+        cp->hits += shards[i].cp.hits;
+        cp->misses += shards[i].cp.misses;
+        cp->evictions += shards[i].cp.evictions;
+        free(shards[i].ring);
+    }
+
+    free(shards);
+}
@@ -0,0 +1,20 @@
+/*
+ * parsim.h - Set-partitioned multi-threaded simulation for csim
+ *
+ * Every reference touches exactly one set, and sets never interact, so the
+ * sets of a cache can be split into contiguous ranges ("shards") that are
+ * simulated by separate threads. The calling thread decodes the trace and
+ * routes each reference to its shard through a single-producer,
+ * single-consumer ring buffer. Each set sees its references in trace order,
+ * so the merged counts are identical to a serial run.
+ */
+
+#ifndef PARSIM_H
+#define PARSIM_H
+
+#include "cache.h"
+#include "trace.h"
+
+void simulate_cache_parallel(cache_performance *cp, cache *sim_cache, trace_reader *trace, int num_threads);
+
+#endif /* PARSIM_H */
@@ -0,0 +1,254 @@
+/*
+ * prefetch.c - Hardware prefetcher models for the simulator
+ */
+
+#include "prefetch.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Names accepted in a prefetcher spec, indexed by enum PrefetcherKind, and the default degree and table size of each
+static const char *prefetcher_names[] = {"next", "stride", "stream"};
+static const int default_degree[] = {1, 2, 4};
+static const int default_entries[] = {0, 64, 8};
+
+//Times in a row a stride must repeat before the stride prefetcher trusts it
+#define RPT_CONFIDENT 2
+
+/**
+ * Parses a prefetcher spec, kind[:degree[:entries]].
+ * @param spec spec from the command line, e.g. "stream:4:16"
+ * @param config filled in with the prefetcher, using the kind's defaults for what the spec leaves out
+ * @return whether the spec was valid
+ */
+bool parse_prefetcher(const char *spec, prefetch_config *config) {
+    const char *colon = strchr(spec, ':');
+    size_t name_length = colon != NULL ? (size_t) (colon - spec) : strlen(spec);
+    int kind = -1;
+    for(int i = 0; i < (int) (sizeof(prefetcher_names) / sizeof(prefetcher_names[0])); i++) {
+        if(strlen(prefetcher_names[i]) == name_length && strncmp(spec, prefetcher_names[i], name_length) == 0) {
+            kind = i;
+        }
+    }
+    if(kind < 0) {
+        return false;
+    }
+
+    config->kind = (enum PrefetcherKind) kind;
+    config->degree = default_degree[kind];
+    config->entries = default_entries[kind];
+
+    //Up to two numbers follow the name
+    int *fields[] = {&config->degree, &config->entries};
+    const char *p = colon;
+    for(int field = 0; field < 2 && p != NULL; field++) {
+        char *end;
+        *fields[field] = (int) strtol(p + 1, &end, 10);
+        if(end == p + 1 || (*end != '\0' && *end != ':')) {
+            return false;
+        }
+        p = *end == ':' ? end : NULL;
+    }
+    if(p != NULL) {
+        return false;
+    }
+
+    if(config->degree < 1 || config->degree > PREFETCH_MAX_DEGREE) {
+        return false;
+    }
+    if(config->kind == PREFETCH_STRIDE) {
+        return config->entries >= 1 && config->entries <= PREFETCH_MAX_STRIDE_ENTRIES &&
+               (config->entries & (config->entries - 1)) == 0;
+    }
+    if(config->kind == PREFETCH_STREAM) {
+        return config->entries >= 1 && config->entries <= PREFETCH_MAX_STREAMS;
+    }
+    return true;
+}
+
+/**
+ * Allocates a prefetcher with empty tables.
+ * @param config what kind of prefetcher, as checked by parse_prefetcher
+ * @param num_lines number of lines of the cache it prefetches into
+ * @return the prefetcher
+ */
+prefetcher *prefetcher_create(const prefetch_config *config, int num_lines) {
+    prefetcher *pf = (prefetcher *) calloc(1, sizeof(prefetcher));
+    pf->config = *config;
+    pf->num_lines = num_lines;
+    pf->unused = (unsigned char *) malloc(num_lines);
+    if(config->kind == PREFETCH_STRIDE) {
+        pf->table = (rpt_entry *) malloc(sizeof(rpt_entry) * config->entries);
+    } else if(config->kind == PREFETCH_STREAM) {
+        pf->streams = (stream_entry *) malloc(sizeof(stream_entry) * config->entries);
+    }
+    prefetcher_reset(pf);
+    return pf;
+}
+
+/**
+ * Empties a prefetcher's tables and forgets which lines were prefetched, to go with an emptied cache.
+ * @param pf prefetcher to reset
+ */
+void prefetcher_reset(prefetcher *pf) {
+    memset(pf->unused, 0, pf->num_lines);
+    if(pf->table) {
+        memset(pf->table, 0, sizeof(rpt_entry) * pf->config.entries);
+    }
+    if(pf->streams) {
+        memset(pf->streams, 0, sizeof(stream_entry) * pf->config.entries);
+    }
+    pf->pc = 0;
+    pf->have_pc = false;
+    pf->clock = 0;
+}
+
+/**
+ * Frees a prefetcher.
+ * @param pf prefetcher to free, set to NULL
+ */
+void prefetcher_free(prefetcher **pf) {
+    free((*pf)->unused);
+    free((*pf)->table);
+    free((*pf)->streams);
+    free(*pf);
+    *pf = NULL;
+}
+
+/**
+ * Lists the blocks that follow one in a direction.
+ * @param block block to start after
+ * @param dir +1 or -1
+ * @param degree number of blocks
+ * @param blocks filled in with the blocks, stopping at either end of the address space
+ * @return the number of blocks listed
+ */
+static int next_blocks(unsigned long long block, int dir, int degree, unsigned long long *blocks) {
+    int count = 0;
+    for(int k = 1; k <= degree; k++) {
+        if((dir < 0 && block < (unsigned long long) k) || (dir > 0 && block + k < block)) {
+            break;
+        }
+        blocks[count++] = dir > 0 ? block + k : block - k;
+    }
+    return count;
+}
+
+/**
+ * Stride prefetcher: trains the entry of the current instruction (or page) on the access, and once its stride has
+ * repeated, lists the blocks the next degree strides will touch.
+ * @param pf prefetcher to train
+ * @param address address accessed
+ * @param bbits number of block offset bits
+ * @param blocks filled in with the blocks to prefetch
+ * @return the number of blocks listed
+ */
+static int observe_stride(prefetcher *pf, unsigned long long address, int bbits, unsigned long long *blocks) {
+    unsigned long long key = pf->have_pc ? pf->pc : address >> 12;
+    rpt_entry *entry = &pf->table[((key * 0x9E3779B97F4A7C15ULL) >> 32) & (pf->config.entries - 1)];
+
+    if(!entry->valid || entry->key != key) {
+        entry->key = key;
+        entry->last = address;
+        entry->stride = 0;
+        entry->confidence = 0;
+        entry->valid = true;
+        return 0;
+    }
+
+    long long stride = (long long) (address - entry->last);
+    entry->last = address;
+    if(stride == entry->stride) {
+        if(entry->confidence < 3) {
+            entry->confidence++;
+        }
+    } else if(entry->confidence > 0) {
+        entry->confidence--;
+    } else {
+        entry->stride = stride;
+    }
+    if(entry->confidence < RPT_CONFIDENT || entry->stride == 0) {
+        return 0;
+    }
+
+    //A stride within a block would only name the current block again, so walk the blocks themselves instead
+    unsigned long long block = address >> bbits;
+    long long step = entry->stride;
+    if((step < 0 ? -step : step) < (1LL << bbits)) {
+        return next_blocks(block, step < 0 ? -1 : 1, pf->config.degree, blocks);
+    }
+    int count = 0;
+    for(int k = 1; k <= pf->config.degree; k++) {
+        blocks[count++] = (address + (unsigned long long) (k * step)) >> bbits;
+    }
+    return count;
+}
+
+/**
+ * Stream prefetcher: advances the stream the block continues, or starts a new one in place of the least recently used
+ * stream, and lists the degree blocks ahead of an advanced stream.
+ * @param pf prefetcher to update
+ * @param block block of the miss or first use of a prefetched line
+ * @param blocks filled in with the blocks to prefetch
+ * @return the number of blocks listed
+ */
+static int observe_stream(prefetcher *pf, unsigned long long block, unsigned long long *blocks) {
+    int degree = pf->config.degree;
+    int replace = 0;
+    pf->clock++;
+
+    for(int i = 0; i < pf->config.entries; i++) {
+        stream_entry *s = &pf->streams[i];
+        if(!s->valid) {
+            replace = i;
+            break;
+        }
+        if(s->stamp < pf->streams[replace].stamp) {
+            replace = i;
+        }
+
+        //A new stream takes its direction from its second block. After that, the stream is ahead of the accesses by
+        //    up to degree blocks, so the next trigger may be anywhere in that window.
+        long long distance = (long long) (block - s->last);
+        bool follows = s->dir == 0 ? distance == 1 || distance == -1
+                                   : distance * s->dir >= 1 && distance * s->dir <= degree + 1;
+        if(follows) {
+            if(s->dir == 0) {
+                s->dir = distance > 0 ? 1 : -1;
+            }
+            s->last = block;
+            s->stamp = pf->clock;
+            return next_blocks(block, s->dir, degree, blocks);
+        }
+    }
+
+    stream_entry *s = &pf->streams[replace];
+    s->last = block;
+    s->dir = 0;
+    s->stamp = pf->clock;
+    s->valid = true;
+    return 0;
+}
+
+/**
+ * Shows a demand access to the prefetcher and gets the blocks it wants fetched, some of which may be cached already.
+ * @param pf prefetcher to update
+ * @param address address accessed
+ * @param bbits number of block offset bits
+ * @param trigger whether the access missed or was the first use of a prefetched line. The next-line and stream
+ *     prefetchers only act on these; the stride prefetcher learns from every access.
+ * @param blocks filled in with the blocks to prefetch, room for PREFETCH_MAX_DEGREE
+ * @return the number of blocks listed
+ */
+int prefetcher_observe(prefetcher *pf, unsigned long long address, int bbits, bool trigger,
+                       unsigned long long *blocks) {
+    switch(pf->config.kind) {
+        case PREFETCH_NEXT:
+            return trigger ? next_blocks(address >> bbits, 1, pf->config.degree, blocks) : 0;
+        case PREFETCH_STRIDE:
+            return observe_stride(pf, address, bbits, blocks);
+        case PREFETCH_STREAM:
+            return trigger ? observe_stream(pf, address >> bbits, blocks) : 0;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * prefetch.h - Hardware prefetcher models for the simulator
+ *
+ * A prefetcher watches the demand accesses and names blocks to bring in
+ * ahead of time. The simulator fills those that are not cached yet into
+ * the cache, like a miss but without counting one. A prefetcher is given
+ * as kind[:degree[:entries]], where degree is how many blocks it fetches
+ * at a time:
+ *
+ *   next    next-line: a miss, or the first use of a prefetched line, on
+ *           block X fetches X+1 .. X+degree (default degree 1)
+ *   stride  a reference prediction table of entries (default 64, a power
+ *           of two) indexed by the instruction address, which learns each
+ *           instruction's stride and, once it has seen it twice in a row,
+ *           fetches the next degree (default 2) strides ahead, or the next
+ *           degree blocks if the stride is shorter than a block. Traces
+ *           without instruction fetches key the table by 4KB page.
+ *   stream  a table of entries (default 8, at most 64) streams, each
+ *           following a run of ascending or descending blocks from the
+ *           miss that started it, and staying degree (default 4) blocks
+ *           ahead of it
+ *
+ * Real stream buffers hold their lines outside the cache until they are
+ * used; here they go straight into the cache, like an L1 streamer's.
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdbool.h>
+
+//Most blocks a prefetcher may fetch at a time, and the largest tables
+#define PREFETCH_MAX_DEGREE 16
+#define PREFETCH_MAX_STRIDE_ENTRIES 65536
+#define PREFETCH_MAX_STREAMS 64
+
+//Enum of the supported prefetchers
+enum PrefetcherKind {PREFETCH_NEXT, PREFETCH_STRIDE, PREFETCH_STREAM};
+
+/**
+ * Struct describing a prefetcher.
+ * @param kind which prefetcher
+ * @param degree how many blocks it fetches at a time
+ * @param entries how many instructions (stride) or streams (stream) it tracks
+ */
+typedef struct prefetch_config {
+    enum PrefetcherKind kind;
+    int degree;
+    int entries;
+} prefetch_config;
+
+/**
+ * Struct holding one entry of the stride prefetcher's reference prediction table.
+ * @param key instruction address (or page) the entry belongs to
+ * @param last address it last accessed
+ * @param stride distance between its last two accesses
+ * @param confidence how many times in a row the stride repeated, at most 3
+ * @param valid whether the entry is in use
+ */
+typedef struct rpt_entry {
+    unsigned long long key;
+    unsigned long long last;
+    long long stride;
+    int confidence;
+    bool valid;
+} rpt_entry;
+
+/**
+ * Struct holding one stream of the stream prefetcher.
+ * @param last block the stream last advanced to
+ * @param dir +1 or -1 once the stream's direction is known, 0 before
+ * @param stamp when the stream last advanced, to replace the least recently used one
+ * @param valid whether the stream is in use
+ */
+typedef struct stream_entry {
+    unsigned long long last;
+    int dir;
+    unsigned long long stamp;
+    bool valid;
+} stream_entry;
+
+/**
+ * Struct holding a prefetcher's state.
+ * @param config what kind of prefetcher it is
+ * @param unused one byte per line of the cache, set while the line holds a prefetched block not used yet
+ * @param num_lines number of lines of the cache
+ * @param table reference prediction table, for stride
+ * @param streams stream table, for stream
+ * @param pc address of the last instruction fetch in the trace
+ * @param have_pc whether the trace has had an instruction fetch
+ * @param clock number of times the stream table was consulted
+ */
+typedef struct prefetcher {
+    prefetch_config config;
+    unsigned char *unused;
+    int num_lines;
+    rpt_entry *table;
+    stream_entry *streams;
+    unsigned long long pc;
+    bool have_pc;
+    unsigned long long clock;
+} prefetcher;
+
+bool parse_prefetcher(const char *spec, prefetch_config *config);
+prefetcher *prefetcher_create(const prefetch_config *config, int num_lines);
+int prefetcher_observe(prefetcher *pf, unsigned long long address, int bbits, bool trigger,
+                       unsigned long long *blocks);
+void prefetcher_reset(prefetcher *pf);
+void prefetcher_free(prefetcher **pf);
+
+#endif /* PREFETCH_H */
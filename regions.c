@@ -0,0 +1,188 @@
+/*
+ * regions.c - Per-region breakdown of a simulator's counts
+ */
+
+#include "regions.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Allocates a region map with every count at 0.
+ * @param regions named regions, copied into the map
+ * @param num_regions number of named regions, at most MAX_REGIONS
+ * @param num_sets number of sets of the cache the counts are for
+ * @return the map, or NULL if there are too many regions
+ */
+region_map *region_map_create(const region *regions, int num_regions, int num_sets) {
+    if(num_regions < 0 || num_regions > MAX_REGIONS) {
+        return NULL;
+    }
+
+    region_map *map = (region_map *) calloc(1, sizeof(region_map));
+    map->num_regions = num_regions;
+    memcpy(map->regions, regions, sizeof(region) * num_regions);
+    map->num_sets = num_sets;
+    map->evicted_by = (unsigned long long *) calloc((size_t) num_sets * (num_regions + 1) * (num_regions + 1),
+                                                    sizeof(unsigned long long));
+    return map;
+}
+
+/**
+ * Finds the region an address belongs to.
+ * @param map map to search
+ * @param address address to look up
+ * @return index of the first named region containing the address, or num_regions ("other") if none does
+ */
+int region_of(const region_map *map, unsigned long long address) {
+    for(int i = 0; i < map->num_regions; i++) {
+        if(address >= map->regions[i].start && address < map->regions[i].end) {
+            return i;
+        }
+    }
+    return map->num_regions;
+}
+
+/**
+ * Zeroes every count of a region map, keeping its regions.
+ * @param map map to reset
+ */
+void region_map_reset(region_map *map) {
+    int slots = map->num_regions + 1;
+    memset(map->counts, 0, sizeof(map->counts));
+    memset(map->evicted_by, 0, sizeof(unsigned long long) * map->num_sets * slots * slots);
+}
+
+/**
+ * Frees a region map.
+ * @param map map to free, set to NULL
+ */
+void region_map_free(region_map **map) {
+    free((*map)->evicted_by);
+    free(*map);
+    *map = NULL;
+}
+
+/**
+ * Returns the name of a region of a map.
+ * @param map map holding the region
+ * @param r region index, num_regions for "other"
+ * @return the region's name
+ */
+static const char *region_name(const region_map *map, int r) {
+    return r < map->num_regions ? map->regions[r].name : "other";
+}
+
+/**
+ * Prints the counts of every region, the evictions between each pair of regions, and the evictions between each pair
+ * in every set that had any. Pairs that never evicted each other are left out of the per-set table.
+ * @param map map to print
+ * @param classify whether to add the compulsory, capacity and conflict miss columns
+ */
+void region_map_print(const region_map *map, bool classify) {
+    int slots = map->num_regions + 1;
+
+    printf("%-12s %12s %12s %12s %12s", "region", "hits", "misses", "evictions", "evicted");
+    if(classify) {
+        printf(" %12s %12s %12s", "compulsory", "capacity", "conflict");
+    }
+    printf("\n");
+    for(int r = 0; r < slots; r++) {
+        const region_counts *rc = &map->counts[r];
+        printf("%-12s %12llu %12llu %12llu %12llu", region_name(map, r), rc->hits, rc->misses, rc->evictions,
+               rc->evicted);
+        if(classify) {
+            printf(" %12llu %12llu %12llu", rc->compulsory, rc->capacity, rc->conflict);
+        }
+        printf("\n");
+    }
+
+    //Add up each pair over the sets, which also tells which pairs the per-set table needs
+    unsigned long long *totals = (unsigned long long *) calloc(slots * slots, sizeof(unsigned long long));
+    for(int set = 0; set < map->num_sets; set++) {
+        for(int pair = 0; pair < slots * slots; pair++) {
+            totals[pair] += map->evicted_by[(size_t) set * slots * slots + pair];
+        }
+    }
+
+    printf("Evictions (row: region evicted, column: region whose miss evicted it)\n");
+    printf("%-12s", "");
+    for(int evictor = 0; evictor < slots; evictor++) {
+        printf(" %12s", region_name(map, evictor));
+    }
+    printf("\n");
+    for(int victim = 0; victim < slots; victim++) {
+        printf("%-12s", region_name(map, victim));
+        for(int evictor = 0; evictor < slots; evictor++) {
+            printf(" %12llu", totals[victim * slots + evictor]);
+        }
+        printf("\n");
+    }
+
+    printf("Evictions per set (evicted<-evictor)\n");
+    printf("%6s", "set");
+    for(int pair = 0; pair < slots * slots; pair++) {
+        if(totals[pair] > 0) {
+            char label[2 * REGION_NAME + 3];
+            snprintf(label, sizeof(label), "%s<-%s", region_name(map, pair / slots), region_name(map, pair % slots));
+            printf(" %12s", label);
+        }
+    }
+    printf("\n");
+    for(int set = 0; set < map->num_sets; set++) {
+        const unsigned long long *counts = &map->evicted_by[(size_t) set * slots * slots];
+        bool any = false;
+        for(int pair = 0; pair < slots * slots; pair++) {
+            any |= counts[pair] > 0;
+        }
+        if(!any) {
+            continue;
+        }
+        printf("%6d", set);
+        for(int pair = 0; pair < slots * slots; pair++) {
+            if(totals[pair] > 0) {
+                printf(" %12llu", counts[pair]);
+            }
+        }
+        printf("\n");
+    }
+    free(totals);
+}
+
+/**
+ * Reads the regions tracegen writes to .regions: one "name start end" line per region, with start and end in hex and
+ * end exclusive.
+ * @param path file to read
+ * @param regions filled in with the regions, MAX_REGIONS at most
+ * @param num_regions filled in with the number of regions
+ * @return whether the file could be read and every line was well formed
+ */
+bool regions_load(const char *path, region *regions, int *num_regions) {
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return false;
+    }
+
+    char line[256];
+    bool valid = true;
+    *num_regions = 0;
+    while(valid && fgets(line, sizeof(line), fp) != NULL) {
+        char name[REGION_NAME];
+        unsigned long long start, end;
+        int fields = sscanf(line, "%15s %llx %llx", name, &start, &end);
+        if(fields <= 0) {
+            //Blank line
+            continue;
+        }
+        if(fields != 3 || start >= end || *num_regions == MAX_REGIONS) {
+            valid = false;
+            break;
+        }
+        region *r = &regions[(*num_regions)++];
+        strcpy(r->name, name);
+        r->start = start;
+        r->end = end;
+    }
+    fclose(fp);
+    return valid;
+}
@@ -0,0 +1,82 @@
+/*
+ * regions.h - Per-region breakdown of a simulator's counts
+ *
+ * A region is a named range of addresses, such as a matrix or the stack.
+ * tracegen writes the regions of the function it traces to .regions, one
+ * "name start end" line each with the addresses in hex and end exclusive,
+ * and test-trans gets them from tracegen directly. Addresses outside every
+ * region belong to an implicit last region, "other".
+ *
+ * With a region map, a simulator counts hits, misses and evictions (and
+ * the 3C split, if it classifies misses) for each region. Every eviction
+ * is also counted in a conflict matrix per set: by the region of the line
+ * that was evicted and by the region whose miss evicted it. Evictions of
+ * A by B and of B by A piling up in the same sets are the diagonal
+ * conflicts of a transpose.
+ */
+
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include <stdbool.h>
+
+//Most named regions a map can hold, and the longest region name
+#define MAX_REGIONS 8
+#define REGION_NAME 16
+
+/**
+ * Struct describing one named range of addresses.
+ * @param name region name, as printed
+ * @param start first address in the region
+ * @param end first address past the region
+ */
+typedef struct region {
+    char name[REGION_NAME];
+    unsigned long long start;
+    unsigned long long end;
+} region;
+
+/**
+ * Struct to store the counts of the accesses to one region.
+ * @param hits number of hits on the region
+ * @param misses number of misses on the region
+ * @param evictions number of lines the region's misses evicted
+ * @param evicted number of the region's lines that were evicted
+ * @param compulsory the region's compulsory misses
+ * @param capacity the region's capacity misses
+ * @param conflict the region's conflict misses
+ */
+typedef struct region_counts {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long evicted;
+    unsigned long long compulsory;
+    unsigned long long capacity;
+    unsigned long long conflict;
+} region_counts;
+
+/**
+ * Struct holding the regions of one simulator and their counts.
+ * @param num_regions number of named regions. Region num_regions is "other".
+ * @param regions the named regions
+ * @param counts counts of each region, including "other"
+ * @param num_sets number of sets of the simulated cache
+ * @param evicted_by evictions in each set, indexed by (set * (num_regions + 1) + victim) * (num_regions + 1) + evictor
+ */
+typedef struct region_map {
+    int num_regions;
+    region regions[MAX_REGIONS];
+    region_counts counts[MAX_REGIONS + 1];
+    int num_sets;
+    unsigned long long *evicted_by;
+} region_map;
+
+region_map *region_map_create(const region *regions, int num_regions, int num_sets);
+int region_of(const region_map *map, unsigned long long address);
+void region_map_reset(region_map *map);
+void region_map_free(region_map **map);
+void region_map_print(const region_map *map, bool classify);
+bool regions_load(const char *path, region *regions, int *num_regions);
+
+#endif /* REGIONS_H */
@@ -0,0 +1,614 @@
+/*
+ * simulator.c - csim's simulation engine as a library
+ */
+
+#include "simulator.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void simulate_batch(simulator *sim, const trace_ref *refs, int count);
+static void simulate_write_batch(simulator *sim, const trace_ref *refs, int count);
+static void simulate_region_batch(simulator *sim, const trace_ref *refs, int count);
+static void simulate_prefetch_batch(simulator *sim, const trace_ref *refs, int count);
+static void simulate_victim_batch(simulator *sim, const trace_ref *refs, int count);
+static enum ShadowResult classify_access(simulator *sim, unsigned long long address, int result);
+
+/**
+ * Allocates a simulator with an empty cache of the given geometry, counting from 0.
+ * @param s number of set index bits, at most 30
+ * @param E number of lines per set
+ * @param b number of block offset bits
+ * @param policy replacement policy
+ * @return the simulator, or NULL if the geometry is invalid or the policy cannot handle it (plru needs E to be a power
+ *     of two no larger than 64)
+ */
+simulator *simulator_create(int s, int E, int b, enum ReplacementPolicy policy) {
+    if(s < 0 || s > 30 || b < 0 || s + b >= 64 || E < 1) {
+        return NULL;
+    }
+    if(policy == POLICY_PLRU && (E > 64 || (E & (E - 1)) != 0)) {
+        return NULL;
+    }
+
+    simulator *sim = (simulator *) calloc(1, sizeof(simulator));
+    setup_cache(&sim->sim_cache, s, E, b, 64 - (s + b), policy);
+    return sim;
+}
+
+/**
+ * Makes the simulator sort its misses into compulsory, capacity and conflict misses from now on, using a fully
+ * associative LRU shadow cache with as many lines as its cache. Call it before feeding any references.
+ * @param sim simulator to classify the misses of
+ */
+void simulator_classify(simulator *sim) {
+    if(sim->shadow == NULL) {
+        sim->shadow = classifier_create((unsigned long long) sim->sim_cache->num_sets * sim->sim_cache->lines_per_set);
+    }
+}
+
+/**
+ * Makes the simulator break its counts down by region from now on, replacing the regions it had, if any. The region
+ * counts start at 0, so call it before feeding the references to break down.
+ * @param sim simulator to break the counts of down
+ * @param regions named regions, copied into the simulator
+ * @param num_regions number of named regions, at most MAX_REGIONS
+ * @return whether the regions were taken, false if there are too many
+ */
+bool simulator_regions(simulator *sim, const region *regions, int num_regions) {
+    region_map *map = region_map_create(regions, num_regions, sim->sim_cache->num_sets);
+    if(map == NULL) {
+        return false;
+    }
+    if(sim->regions) {
+        region_map_free(&sim->regions);
+    }
+    sim->regions = map;
+    return true;
+}
+
+/**
+ * Gives the simulator a prefetcher, replacing the one it had, if any. Call it before feeding any references.
+ * @param sim simulator to prefetch for
+ * @param config prefetcher to use, as checked by parse_prefetcher
+ */
+void simulator_prefetch(simulator *sim, const prefetch_config *config) {
+    if(sim->prefetch) {
+        prefetcher_free(&sim->prefetch);
+    }
+    sim->prefetch = prefetcher_create(config, sim->sim_cache->num_sets * sim->sim_cache->lines_per_set);
+}
+
+/**
+ * Gives the simulator a victim or miss cache, replacing the one it had, if any. Call it before feeding any references.
+ * @param sim simulator to add the buffer to
+ * @param config buffer to use, as checked by parse_victim_buffer
+ */
+void simulator_victim(simulator *sim, const victim_config *config) {
+    if(sim->victim) {
+        victim_buffer_free(&sim->victim);
+    }
+    sim->victim = victim_buffer_create(config);
+}
+
+/**
+ * Runs a batch of decoded references through the simulator's cache, adding to its counts.
+ * @param sim simulator to drive
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+void simulator_feed(simulator *sim, const trace_ref *refs, int count) {
+    if(sim->sim_cache->split_lines) {
+        count = trace_split_batch(refs, count, sim->sim_cache->bytes_per_line, &sim->split, &sim->split_size);
+        refs = sim->split;
+    }
+
+    if(sim->regions) {
+        simulate_region_batch(sim, refs, count);
+    } else if(sim->model_writes) {
+        simulate_write_batch(sim, refs, count);
+    } else if(sim->prefetch) {
+        simulate_prefetch_batch(sim, refs, count);
+    } else if(sim->victim) {
+        simulate_victim_batch(sim, refs, count);
+    } else {
+        simulate_batch(sim, refs, count);
+    }
+}
+
+/**
+ * Reads the simulator's counts.
+ * @param sim simulator to read
+ * @param cp filled in with the counts since the simulator was created or last reset
+ */
+void simulator_stats(const simulator *sim, cache_performance *cp) {
+    *cp = sim->perf;
+}
+
+/**
+ * Empties the simulator's cache and zeroes its counts, keeping its geometry, policies and options.
+ * @param sim simulator to reset
+ */
+void simulator_reset(simulator *sim) {
+    reset_cache(sim->sim_cache);
+    if(sim->shadow) {
+        classifier_reset(sim->shadow);
+    }
+    if(sim->regions) {
+        region_map_reset(sim->regions);
+    }
+    if(sim->prefetch) {
+        prefetcher_reset(sim->prefetch);
+    }
+    if(sim->victim) {
+        victim_buffer_reset(sim->victim);
+    }
+    memset(&sim->perf, 0, sizeof(cache_performance));
+}
+
+/**
+ * Frees a simulator and its cache.
+ * @param sim simulator to free, set to NULL
+ */
+void simulator_free(simulator **sim) {
+    free_cache(&(*sim)->sim_cache);
+    if((*sim)->shadow) {
+        classifier_free(&(*sim)->shadow);
+    }
+    if((*sim)->regions) {
+        region_map_free(&(*sim)->regions);
+    }
+    if((*sim)->prefetch) {
+        prefetcher_free(&(*sim)->prefetch);
+    }
+    if((*sim)->victim) {
+        victim_buffer_free(&(*sim)->victim);
+    }
+    free((*sim)->split);
+    free(*sim);
+    *sim = NULL;
+}
+
+/**
+ * Runs one batch of decoded references through the cache.
+ * @param sim simulator whose cache and counts to use
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+static void simulate_batch(simulator *sim, const trace_ref *refs, int count) {
+    cache *sim_cache = sim->sim_cache;
+    cache_performance *cp = &sim->perf;
+    location loc;
+
+    for(int i = 0; i < count; i++) {
+        get_set_and_tag(&loc, refs[i].address, sim_cache->tbits, sim_cache->sbits);
+        switch(refs[i].op) {
+            case 'M':
+                cp->hits++;
+            case 'S':
+            case 'L':
+                ;
+                //Load instruction. If HIT, increment. If COLD_MISS, a free line was filled. If MISS, an eviction happened
+                int result = cache_scan(&loc, sim_cache);
+                if(sim->shadow) {
+                    classify_access(sim, refs[i].address, result);
+                }
+                if(sim->events) {
+                    event_log_add(sim->events, refs[i].op, refs[i].address, refs[i].size, result,
+                                  refs[i].op == 'M' ? HIT : EVENT_NONE);
+                }
+                if(result == HIT) {
+                    cp->hits++;
+                } else if(result == COLD_MISS || result == MISS) {
+                    cp->misses++;
+                    if (result == MISS) {
+                        cp->evictions++;
+                    };
+                }
+                break;
+            case 'I':
+                //Instruction instruction. Pass.
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Runs one batch of decoded references through the cache under its write policies. Loads and stores are separate
+ * accesses, so an M is a load followed by a store, which always hits unless the cache does not allocate on a write.
+ * @param sim simulator whose cache and counts to use
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+static void simulate_write_batch(simulator *sim, const trace_ref *refs, int count) {
+    cache *sim_cache = sim->sim_cache;
+    cache_performance *cp = &sim->perf;
+    location loc;
+    cache_victim victim;
+
+    for(int i = 0; i < count; i++) {
+        char op = refs[i].op;
+        if(op != 'L' && op != 'S' && op != 'M') {
+            continue;
+        }
+        get_set_and_tag(&loc, refs[i].address, sim_cache->tbits, sim_cache->sbits);
+
+        //An M is a load, then a store to the same place
+        int outcome[2] = {EVENT_NONE, EVENT_NONE};
+        for(int write = op == 'S'; write <= (op != 'L'); write++) {
+            int result = cache_access(sim_cache, &loc, write, refs[i].size, cp, &victim);
+            outcome[write - (op == 'S')] = result;
+            if(sim->shadow) {
+                classify_access(sim, refs[i].address, result);
+            }
+            if(result == HIT) {
+                cp->hits++;
+            } else {
+                cp->misses++;
+                if(result == MISS) {
+                    cp->evictions++;
+                }
+            }
+        }
+        if(sim->events) {
+            event_log_add(sim->events, op, refs[i].address, refs[i].size, outcome[0], outcome[1]);
+        }
+    }
+}
+
+/**
+ * Looks a location up and either records the hit or fills it in, like cache_scan but reporting the evicted line.
+ * @param sim_cache cache to access
+ * @param loc location being accessed
+ * @param victim filled in with the line that was pushed out, if any
+ * @return HIT, COLD_MISS, or MISS
+ */
+static inline enum HitOrMiss access_line(cache *sim_cache, location *loc, cache_victim *victim) {
+    int way = cache_find(sim_cache, loc);
+    if(way >= 0) {
+        cache_touch(sim_cache, loc, way, false);
+        return HIT;
+    }
+    return cache_fill(sim_cache, loc, false, victim);
+}
+
+/**
+ * Runs one batch of decoded references through the cache, adding every count to the region of the address as well.
+ * Each eviction is also counted by set, region evicted and region whose miss evicted it. Stores go through the cache's
+ * write policies if they are modeled, and otherwise loads, stores and modifies count as in simulate_batch.
+ * @param sim simulator whose cache, regions and counts to use
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+static void simulate_region_batch(simulator *sim, const trace_ref *refs, int count) {
+    cache *sim_cache = sim->sim_cache;
+    cache_performance *cp = &sim->perf;
+    region_map *map = sim->regions;
+    int slots = map->num_regions + 1;
+    location loc;
+    cache_victim victim;
+
+    for(int i = 0; i < count; i++) {
+        char op = refs[i].op;
+        if(op != 'L' && op != 'S' && op != 'M') {
+            continue;
+        }
+        get_set_and_tag(&loc, refs[i].address, sim_cache->tbits, sim_cache->sbits);
+        int r = region_of(map, refs[i].address);
+        region_counts *rc = &map->counts[r];
+
+        //An M is a load, then a store to the same place
+        int outcome[2] = {EVENT_NONE, EVENT_NONE};
+        for(int write = op == 'S'; write <= (op != 'L'); write++) {
+            //Unless writes are modeled, the store of an M always hits and leaves the cache alone
+            if(!sim->model_writes && op == 'M' && write) {
+                outcome[1] = HIT;
+                cp->hits++;
+                rc->hits++;
+                continue;
+            }
+
+            int result = sim->model_writes ? cache_access(sim_cache, &loc, write, refs[i].size, cp, &victim)
+                                           : access_line(sim_cache, &loc, &victim);
+            outcome[write - (op == 'S')] = result;
+            if(sim->shadow) {
+                enum ShadowResult shadow = classify_access(sim, refs[i].address, result);
+                if(result != HIT) {
+                    if(shadow == SHADOW_FIRST) {
+                        rc->compulsory++;
+                    } else if(shadow == SHADOW_MISS) {
+                        rc->capacity++;
+                    } else {
+                        rc->conflict++;
+                    }
+                }
+            }
+
+            if(result == HIT) {
+                cp->hits++;
+                rc->hits++;
+                continue;
+            }
+            cp->misses++;
+            rc->misses++;
+            if(result == MISS) {
+                unsigned long long victim_address = ((victim.loc.tag_id << sim_cache->sbits) | victim.loc.set_id)
+                                                    << sim_cache->bytes_per_line;
+                int v = region_of(map, victim_address);
+                cp->evictions++;
+                rc->evictions++;
+                map->counts[v].evicted++;
+                map->evicted_by[((size_t) loc.set_id * slots + v) * slots + r]++;
+            }
+        }
+        if(sim->events) {
+            event_log_add(sim->events, op, refs[i].address, refs[i].size, outcome[0], outcome[1]);
+        }
+    }
+}
+
+/**
+ * Fills the blocks the prefetcher asks for after a demand access into the cache, skipping those already cached.
+ * @param sim simulator whose cache, prefetcher and counts to use
+ * @param address address of the demand access
+ * @param trigger whether the access missed or was the first use of a prefetched line
+ */
+static void issue_prefetches(simulator *sim, unsigned long long address, bool trigger) {
+    cache *sim_cache = sim->sim_cache;
+    prefetcher *pf = sim->prefetch;
+    cache_performance *cp = &sim->perf;
+    unsigned long long blocks[PREFETCH_MAX_DEGREE];
+    location loc;
+    cache_victim victim;
+
+    int count = prefetcher_observe(pf, address, sim_cache->bytes_per_line, trigger, blocks);
+    for(int k = 0; k < count; k++) {
+        get_set_and_tag(&loc, blocks[k] << sim_cache->bytes_per_line, sim_cache->tbits, sim_cache->sbits);
+        if(cache_find(sim_cache, &loc) >= 0) {
+            continue;
+        }
+
+        size_t base = (size_t) loc.set_id * sim_cache->lines_per_set;
+        int result = cache_fill(sim_cache, &loc, false, &victim);
+        int way = cache_find(sim_cache, &loc);
+        cp->prefetches++;
+        if(result == MISS) {
+            if(pf->unused[base + way]) {
+                cp->useless_prefetches++;
+            } else {
+                cp->pollution++;
+            }
+        }
+        pf->unused[base + way] = 1;
+    }
+}
+
+/**
+ * Runs one batch of decoded references through the cache with the simulator's prefetcher, counting loads, stores and
+ * modifies as in simulate_batch. Instruction fetches are not simulated, but give the stride prefetcher the address
+ * of the instruction making the accesses that follow.
+ * @param sim simulator whose cache, prefetcher and counts to use
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+static void simulate_prefetch_batch(simulator *sim, const trace_ref *refs, int count) {
+    cache *sim_cache = sim->sim_cache;
+    cache_performance *cp = &sim->perf;
+    prefetcher *pf = sim->prefetch;
+    location loc;
+    cache_victim victim;
+
+    for(int i = 0; i < count; i++) {
+        char op = refs[i].op;
+        if(op == 'I') {
+            pf->pc = refs[i].address;
+            pf->have_pc = true;
+            continue;
+        }
+        if(op != 'L' && op != 'S' && op != 'M') {
+            continue;
+        }
+        get_set_and_tag(&loc, refs[i].address, sim_cache->tbits, sim_cache->sbits);
+        size_t base = (size_t) loc.set_id * sim_cache->lines_per_set;
+
+        //A hit on a prefetched line that was not used yet is a prefetch hit, and triggers prefetching like a miss
+        int result;
+        bool trigger;
+        int way = cache_find(sim_cache, &loc);
+        if(way >= 0) {
+            cache_touch(sim_cache, &loc, way, false);
+            result = HIT;
+            trigger = pf->unused[base + way];
+            if(trigger) {
+                pf->unused[base + way] = 0;
+                cp->prefetch_hits++;
+            }
+        } else {
+            result = cache_fill(sim_cache, &loc, false, &victim);
+            way = cache_find(sim_cache, &loc);
+            if(result == MISS && pf->unused[base + way]) {
+                cp->useless_prefetches++;
+            }
+            pf->unused[base + way] = 0;
+            trigger = true;
+        }
+
+        if(sim->shadow) {
+            classify_access(sim, refs[i].address, result);
+        }
+        if(sim->events) {
+            event_log_add(sim->events, op, refs[i].address, refs[i].size, result, op == 'M' ? HIT : EVENT_NONE);
+        }
+        if(op == 'M') {
+            cp->hits++;
+        }
+        if(result == HIT) {
+            cp->hits++;
+        } else {
+            cp->misses++;
+            if(result == MISS) {
+                cp->evictions++;
+            }
+        }
+
+        issue_prefetches(sim, refs[i].address, trigger);
+    }
+}
+
+/**
+ * Runs one batch of decoded references through the cache and the simulator's victim or miss cache, counting loads,
+ * stores and modifies as in simulate_batch. On a miss the buffer is searched for the block. A victim cache then takes
+ * the line the cache evicted, which is a swap if the block came from the buffer; a miss cache takes the block itself
+ * unless it already holds it.
+ * @param sim simulator whose cache, buffer and counts to use
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+static void simulate_victim_batch(simulator *sim, const trace_ref *refs, int count) {
+    cache *sim_cache = sim->sim_cache;
+    cache_performance *cp = &sim->perf;
+    victim_buffer *vb = sim->victim;
+    location loc;
+    cache_victim victim;
+
+    for(int i = 0; i < count; i++) {
+        char op = refs[i].op;
+        if(op != 'L' && op != 'S' && op != 'M') {
+            continue;
+        }
+        get_set_and_tag(&loc, refs[i].address, sim_cache->tbits, sim_cache->sbits);
+        int result = access_line(sim_cache, &loc, &victim);
+
+        if(sim->shadow) {
+            classify_access(sim, refs[i].address, result);
+        }
+        if(sim->events) {
+            event_log_add(sim->events, op, refs[i].address, refs[i].size, result, op == 'M' ? HIT : EVENT_NONE);
+        }
+        if(op == 'M') {
+            cp->hits++;
+        }
+        if(result == HIT) {
+            cp->hits++;
+            continue;
+        }
+        cp->misses++;
+        if(result == MISS) {
+            cp->evictions++;
+        }
+
+        unsigned long long block = refs[i].address >> sim_cache->bytes_per_line;
+        bool found = victim_buffer_lookup(vb, block);
+        if(found) {
+            cp->victim_hits++;
+        }
+        if(vb->config.kind == MISS_CACHE) {
+            if(!found) {
+                victim_buffer_insert(vb, block);
+            }
+        } else if(result == MISS) {
+            victim_buffer_insert(vb, (victim.loc.tag_id << sim_cache->sbits) | victim.loc.set_id);
+            if(found) {
+                cp->victim_swaps++;
+            }
+        }
+    }
+}
+
+/**
+ * Runs one access through the shadow cache and, if the real cache missed, counts the class of the miss.
+ * @param sim simulator whose shadow cache and counts to use
+ * @param address address accessed
+ * @param result what the real cache did
+ * @return what the shadow cache did
+ */
+static enum ShadowResult classify_access(simulator *sim, unsigned long long address, int result) {
+    enum ShadowResult shadow = classifier_access(sim->shadow, address >> sim->sim_cache->bytes_per_line);
+    if(result == HIT) {
+        return shadow;
+    }
+    if(shadow == SHADOW_FIRST) {
+        sim->perf.compulsory++;
+    } else if(shadow == SHADOW_MISS) {
+        sim->perf.capacity++;
+    } else {
+        sim->perf.conflict++;
+    }
+    return shadow;
+}
+
+/**
+ * Parses one field of a geometry spec: either a single number or an inclusive range "lo-hi".
+ * @param p cursor into the spec, advanced past the field
+ * @param lo filled in with the first value
+ * @param hi filled in with the last value
+ * @return whether the field was well formed
+ */
+bool parse_range(const char **p, int *lo, int *hi) {
+    char *end;
+    *lo = strtol(*p, &end, 10);
+    if(end == *p) {
+        return false;
+    }
+    *hi = *lo;
+    if(*end == '-') {
+        const char *start = end + 1;
+        *hi = strtol(start, &end, 10);
+        if(end == start) {
+            return false;
+        }
+    }
+    *p = end;
+    return *lo <= *hi;
+}
+
+/**
+ * Appends the geometries described by spec to the list. spec is a comma separated list of s:E:b triples, where each
+ * field is a number or an inclusive range, e.g. "5:1:5,2-8:1-4:4" is (5,1,5) followed by every combination of
+ * s = 2..8, E = 1..4 and b = 4.
+ * @param spec geometry list from the command line
+ * @param geometries list to grow, may start out NULL
+ * @param num_geometries number of entries in the list, updated
+ * @return whether the whole spec was valid
+ */
+bool parse_geometries(const char *spec, geometry **geometries, int *num_geometries) {
+    const char *p = spec;
+
+    while(true) {
+        int lo[3], hi[3];
+        for(int field = 0; field < 3; field++) {
+            if(!parse_range(&p, &lo[field], &hi[field])) {
+                return false;
+            }
+            if(field < 2 && *p++ != ':') {
+                return false;
+            }
+        }
+
+        //s and b must leave room for a tag, and a set needs at least one line
+        if(lo[0] < 0 || lo[1] < 1 || lo[2] < 0 || hi[0] + hi[2] >= 64 || hi[0] > 30) {
+            return false;
+        }
+
+        int added = (hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+        *geometries = (geometry *) realloc(*geometries, sizeof(geometry) * (*num_geometries + added));
+        for(int s = lo[0]; s <= hi[0]; s++) {
+            for(int E = lo[1]; E <= hi[1]; E++) {
+                for(int b = lo[2]; b <= hi[2]; b++) {
+                    geometry *g = &(*geometries)[(*num_geometries)++];
+                    g->s = s;
+                    g->E = E;
+                    g->b = b;
+                }
+            }
+        }
+
+        if(*p == '\0') {
+            return true;
+        }
+        if(*p++ != ',') {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * simulator.h - csim's simulation engine as a library
+ *
+ * A simulator owns one cache and the counts it has accumulated. Callers
+ * create one for a geometry, feed it batches of decoded references (read
+ * from a trace with trace_read_batch, or recorded in memory), read the
+ * counts back, and reset it to run another stream through the same cache.
+ * csim is a command line front end over this API, and test-trans uses it
+ * directly on the references it records, so neither has to go through a
+ * trace file or another process.
+ *
+ * parse_geometries reads the "s:E:b,..." geometry lists (with ranges)
+ * that csim -g and test-trans -g take.
+ *
+ * Like csim, an M counts as a load that may miss followed by a store that
+ * always hits, unless write traffic is modeled, in which case the store is
+ * a separate access under the cache's write policies (see cache_access).
+ *
+ * simulator_classify makes a simulator also sort its misses into
+ * compulsory, capacity and conflict misses (see classify.h). Every load
+ * and store then goes through the shadow cache as well, including stores
+ * a write-no-allocate cache does not keep, so under that policy a store
+ * miss may be counted as conflict rather than capacity.
+ *
+ * simulator_regions makes a simulator also break its counts down by
+ * address region (see regions.h). It then looks up every line it evicts,
+ * which takes a slower path through the cache than plain counting.
+ *
+ * simulator_prefetch adds a prefetcher (see prefetch.h), whose fills go
+ * into the cache without counting as misses. Prefetching does not model
+ * write policies or regions, which take precedence over it.
+ *
+ * simulator_victim adds a victim cache or a miss cache (see victim.h)
+ * that the cache consults on every miss. The cache's own counts stay
+ * what they would be without it. It does not model write policies,
+ * regions or prefetching, which take precedence over it.
+ *
+ * A simulator given an event log (see events.h) adds every data reference
+ * to it along with what the cache did, which is how csim -v and -e work.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "cache.h"
+#include "trace.h"
+#include "classify.h"
+#include "regions.h"
+#include "events.h"
+#include "prefetch.h"
+#include "victim.h"
+
+/**
+ * Struct holding one simulated cache and its counts.
+ * @param sim_cache the cache, whose split_lines and write policy fields may be set after creation
+ * @param perf counts since the simulator was created or last reset
+ * @param model_writes whether to apply the cache's write policies and count write traffic
+ * @param shadow fully associative shadow cache that classifies misses, or NULL when misses are not classified
+ * @param regions regions the counts are broken down by, or NULL when they are not
+ * @param prefetch prefetcher bringing blocks into the cache ahead of the accesses, or NULL
+ * @param victim victim or miss cache consulted on every miss, or NULL
+ * @param events stream every data reference is written to with its outcome, or NULL. It belongs to the caller, who
+ *     may set it after creation.
+ * @param split buffer for batches with their straddling accesses split, when sim_cache->split_lines is set
+ * @param split_size number of references split can hold
+ */
+typedef struct simulator {
+    cache *sim_cache;
+    cache_performance perf;
+    bool model_writes;
+    classifier *shadow;
+    region_map *regions;
+    prefetcher *prefetch;
+    victim_buffer *victim;
+    event_log *events;
+    trace_ref *split;
+    int split_size;
+} simulator;
+
+/**
+ * Struct describing one cache geometry to simulate.
+ * @param s number of set index bits
+ * @param E number of lines per set
+ * @param b number of block offset bits
+ */
+typedef struct geometry {
+    int s;
+    int E;
+    int b;
+} geometry;
+
+simulator *simulator_create(int s, int E, int b, enum ReplacementPolicy policy);
+void simulator_classify(simulator *sim);
+bool simulator_regions(simulator *sim, const region *regions, int num_regions);
+void simulator_prefetch(simulator *sim, const prefetch_config *config);
+void simulator_victim(simulator *sim, const victim_config *config);
+void simulator_feed(simulator *sim, const trace_ref *refs, int count);
+void simulator_stats(const simulator *sim, cache_performance *cp);
+void simulator_reset(simulator *sim);
+void simulator_free(simulator **sim);
+bool parse_range(const char **p, int *lo, int *hi);
+bool parse_geometries(const char *spec, geometry **geometries, int *num_geometries);
+
+#endif /* SIMULATOR_H */
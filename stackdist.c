@@ -0,0 +1,266 @@
+/*
+ * stackdist.c - Single-pass LRU stack distance (Mattson) analysis
+ */
+
+#include "stackdist.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Positions each set's Fenwick tree starts out with */
+#define SD_INITIAL_CAPACITY 16
+
+/**
+ * Adds delta at position pos of a Fenwick tree.
+ * @param tree 1-indexed Fenwick tree
+ * @param capacity number of positions in the tree
+ * @param pos position to update
+ * @param delta amount to add
+ */
+static void fenwick_add(int *tree, int capacity, int pos, int delta) {
+    for(; pos <= capacity; pos += pos & -pos) {
+        tree[pos] += delta;
+    }
+}
+
+/**
+ * Sums positions 1..pos of a Fenwick tree.
+ * @param tree 1-indexed Fenwick tree
+ * @param pos last position to include
+ * @return the prefix sum
+ */
+static int fenwick_sum(const int *tree, int pos) {
+    int sum = 0;
+    for(; pos > 0; pos -= pos & -pos) {
+        sum += tree[pos];
+    }
+    return sum;
+}
+
+static inline unsigned int hash_block(unsigned long long block, int hash_size) {
+    return (unsigned int) ((block * 0x9E3779B97F4A7C15ULL) >> 32) & (hash_size - 1);
+}
+
+/**
+ * Allocates the analysis state for one set index width and block size.
+ * @param sbits number of set index bits, 0 for a fully associative cache
+ * @param bbits number of block offset bits
+ * @return the new analysis
+ */
+stack_dist *stackdist_create(int sbits, int bbits) {
+    stack_dist *sd = (stack_dist *) calloc(1, sizeof(stack_dist));
+    sd->sbits = sbits;
+    sd->bbits = bbits;
+
+    int num_sets = 1 << sbits;
+    sd->sets = (sd_set *) calloc(num_sets, sizeof(sd_set));
+    for(int i = 0; i < num_sets; i++) {
+        sd->sets[i].capacity = SD_INITIAL_CAPACITY;
+        sd->sets[i].tree = (int *) calloc(SD_INITIAL_CAPACITY + 1, sizeof(int));
+        sd->sets[i].entry = (int *) malloc(sizeof(int) * (SD_INITIAL_CAPACITY + 1));
+    }
+
+    sd->hash_size = 1024;
+    sd->keys = (unsigned long long *) malloc(sizeof(unsigned long long) * sd->hash_size);
+    sd->positions = (int *) calloc(sd->hash_size, sizeof(int));
+
+    sd->histogram_size = 16;
+    sd->histogram = (unsigned long long *) calloc(sd->histogram_size, sizeof(unsigned long long));
+    return sd;
+}
+
+/**
+ * Doubles the hash table. The entry arrays point at hash slots, so they are rewritten as blocks move.
+ * @param sd analysis whose table is full
+ */
+static void grow_hash(stack_dist *sd) {
+    int old_size = sd->hash_size;
+    unsigned long long *old_keys = sd->keys;
+    int *old_positions = sd->positions;
+    unsigned long long set_mask = (1ULL << sd->sbits) - 1;
+
+    sd->hash_size *= 2;
+    sd->keys = (unsigned long long *) malloc(sizeof(unsigned long long) * sd->hash_size);
+    sd->positions = (int *) calloc(sd->hash_size, sizeof(int));
+
+    for(int i = 0; i < old_size; i++) {
+        if(old_positions[i] == 0) {
+            continue;
+        }
+        unsigned int slot = hash_block(old_keys[i], sd->hash_size);
+        while(sd->positions[slot] != 0) {
+            slot = (slot + 1) & (sd->hash_size - 1);
+        }
+        sd->keys[slot] = old_keys[i];
+        sd->positions[slot] = old_positions[i];
+        sd->sets[old_keys[i] & set_mask].entry[old_positions[i]] = slot;
+    }
+
+    free(old_keys);
+    free(old_positions);
+}
+
+/**
+ * Renumbers a set whose clock has reached the end of its tree. Only the live blocks keep a position, packed into
+ * 1..live in their existing order, and the tree is resized to twice that so the clock has room to run again. This
+ * keeps every set's memory proportional to the blocks it holds instead of the references it has seen.
+ * @param sd analysis that owns the set
+ * @param set set to compact
+ */
+static void compact_set(stack_dist *sd, sd_set *set) {
+    int capacity = 2 * set->live > SD_INITIAL_CAPACITY ? 2 * set->live : SD_INITIAL_CAPACITY;
+    int *entry = (int *) malloc(sizeof(int) * (capacity + 1));
+    int *tree = (int *) calloc(capacity + 1, sizeof(int));
+
+    int pos = 0;
+    for(int i = 1; i <= set->clock; i++) {
+        if(set->entry[i] >= 0) {
+            pos++;
+            entry[pos] = set->entry[i];
+            sd->positions[entry[pos]] = pos;
+            tree[pos] = 1;
+        }
+    }
+
+    //Linear-time Fenwick construction: push each node's sum up to its parent
+    for(int i = 1; i <= capacity; i++) {
+        int parent = i + (i & -i);
+        if(parent <= capacity) {
+            tree[parent] += tree[i];
+        }
+    }
+
+    free(set->entry);
+    free(set->tree);
+    set->entry = entry;
+    set->tree = tree;
+    set->capacity = capacity;
+    set->clock = pos;
+}
+
+/**
+ * Pushes one block reference onto its set's LRU stack, recording its stack distance.
+ * @param sd analysis to update
+ * @param block address with the block offset shifted away
+ */
+static void stackdist_access(stack_dist *sd, unsigned long long block) {
+    sd_set *set = &sd->sets[block & ((1ULL << sd->sbits) - 1)];
+
+    unsigned int slot = hash_block(block, sd->hash_size);
+    while(sd->positions[slot] != 0 && sd->keys[slot] != block) {
+        slot = (slot + 1) & (sd->hash_size - 1);
+    }
+
+    int pos = sd->positions[slot];
+    if(pos != 0) {
+        //Every marked position after the block's last one is a distinct block used since then
+        int distance = set->live - fenwick_sum(set->tree, pos);
+        if(distance >= sd->histogram_size) {
+            int size = sd->histogram_size;
+            while(size <= distance) {
+                size *= 2;
+            }
+            sd->histogram = (unsigned long long *) realloc(sd->histogram, sizeof(unsigned long long) * size);
+            memset(sd->histogram + sd->histogram_size, 0, sizeof(unsigned long long) * (size - sd->histogram_size));
+            sd->histogram_size = size;
+        }
+        sd->histogram[distance]++;
+
+        fenwick_add(set->tree, set->capacity, pos, -1);
+        set->entry[pos] = -1;
+    } else {
+        //First reference to this block: infinite distance, i.e. a cold miss for every E
+        sd->keys[slot] = block;
+        set->live++;
+        sd->hash_used++;
+    }
+
+    if(set->clock == set->capacity) {
+        compact_set(sd, set);
+    }
+    pos = ++set->clock;
+    fenwick_add(set->tree, set->capacity, pos, 1);
+    set->entry[pos] = slot;
+    sd->positions[slot] = pos;
+
+    //Keep the hash table at most half full
+    if(2 * sd->hash_used > sd->hash_size) {
+        grow_hash(sd);
+    }
+}
+
+/**
+ * Runs a batch of decoded references through the analysis. Instruction fetches are skipped and M counts as a
+ * reference whose store half always hits, exactly as in simulate_batch.
+ * @param sd analysis to update
+ * @param refs decoded references
+ * @param count number of references in the batch
+ */
+void stackdist_batch(stack_dist *sd, const trace_ref *refs, int count) {
+    for(int i = 0; i < count; i++) {
+        switch(refs[i].op) {
+            case 'M':
+                sd->modifies++;
+            case 'S':
+            case 'L':
+                sd->accesses++;
+                stackdist_access(sd, refs[i].address >> sd->bbits);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Returns the associativity past which the counts stop changing: the most distinct blocks any one set has seen.
+ * @param sd finished analysis
+ * @return the largest useful lines_per_set
+ */
+int stackdist_max_lines(stack_dist *sd) {
+    int max_lines = 1;
+    for(int i = 0; i < (1 << sd->sbits); i++) {
+        if(sd->sets[i].live > max_lines) {
+            max_lines = sd->sets[i].live;
+        }
+    }
+    return max_lines;
+}
+
+/**
+ * Computes the counts an LRU cache with the analysis' s and b and the given E would have produced.
+ * @param sd finished analysis
+ * @param lines_per_set associativity (E) to evaluate
+ * @param hits filled in with the number of hits
+ * @param misses filled in with the number of misses
+ * @param evictions filled in with the number of evictions
+ */
+void stackdist_counts(stack_dist *sd, int lines_per_set, unsigned long long *hits, unsigned long long *misses,
+                      unsigned long long *evictions) {
+    //References closer than E to the top of their stack hit
+    unsigned long long stack_hits = 0;
+    for(int d = 0; d < lines_per_set && d < sd->histogram_size; d++) {
+        stack_hits += sd->histogram[d];
+    }
+
+    //Every miss evicts something, except the ones that fill a set's first E lines
+    unsigned long long fills = 0;
+    for(int i = 0; i < (1 << sd->sbits); i++) {
+        fills += sd->sets[i].live < lines_per_set ? sd->sets[i].live : lines_per_set;
+    }
+
+    *hits = stack_hits + sd->modifies;
+    *misses = sd->accesses - stack_hits;
+    *evictions = *misses - fills;
+}
+
+void stackdist_free(stack_dist *sd) {
+    for(int i = 0; i < (1 << sd->sbits); i++) {
+        free(sd->sets[i].tree);
+        free(sd->sets[i].entry);
+    }
+    free(sd->sets);
+    free(sd->keys);
+    free(sd->positions);
+    free(sd->histogram);
+    free(sd);
+}
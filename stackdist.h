@@ -0,0 +1,74 @@
+/*
+ * stackdist.h - Single-pass LRU stack distance (Mattson) analysis
+ *
+ * LRU has the inclusion property: a reference hits in an E-way LRU set
+ * exactly when fewer than E other blocks of that set were touched since the
+ * block was last used. Recording that stack distance for every reference of
+ * a trace gives the hit, miss and eviction counts of every associativity at
+ * once, for a fixed number of set bits s and block bits b. With s = 0 the
+ * result is the miss curve of every fully associative cache size.
+ *
+ * Each set numbers its references with a local clock and keeps a Fenwick
+ * tree with a 1 at the clock value of every block's most recent reference.
+ * The stack distance of a block is the number of 1s after its previous
+ * position, so each reference costs O(log n) rather than a walk down an LRU
+ * list.
+ */
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include "trace.h"
+
+/**
+ * Struct holding the LRU stack of one set
+ * @param capacity number of positions the Fenwick tree covers
+ * @param clock last position handed out
+ * @param live number of distinct blocks seen in the set, which is also the number of marked positions
+ * @param tree Fenwick tree over positions 1..capacity
+ * @param entry for each position, the hash slot of the block most recently referenced there, or -1
+ */
+typedef struct sd_set {
+    int capacity;
+    int clock;
+    int live;
+    int *tree;
+    int *entry;
+} sd_set;
+
+/**
+ * Struct holding the stack distance analysis for one (s, b)
+ * @param sbits number of set index bits
+ * @param bbits number of block offset bits
+ * @param sets LRU stacks, one per set
+ * @param keys block number stored in each hash slot
+ * @param positions position of each slot's block in its set's stack, 0 for an empty slot
+ * @param hash_size number of hash slots, a power of two
+ * @param hash_used number of occupied slots
+ * @param histogram number of references at each stack distance, distance 0 being the most recently used block
+ * @param histogram_size length of histogram
+ * @param accesses number of data references (L, S and M)
+ * @param modifies number of M references, whose store half always hits
+ */
+typedef struct stack_dist {
+    int sbits;
+    int bbits;
+    sd_set *sets;
+    unsigned long long *keys;
+    int *positions;
+    int hash_size;
+    int hash_used;
+    unsigned long long *histogram;
+    int histogram_size;
+    unsigned long long accesses;
+    unsigned long long modifies;
+} stack_dist;
+
+stack_dist *stackdist_create(int sbits, int bbits);
+void stackdist_batch(stack_dist *sd, const trace_ref *refs, int count);
+int stackdist_max_lines(stack_dist *sd);
+void stackdist_counts(stack_dist *sd, int lines_per_set, unsigned long long *hits, unsigned long long *misses,
+                      unsigned long long *evictions);
+void stackdist_free(stack_dist *sd);
+
+#endif /* STACKDIST_H */
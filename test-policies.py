@@ -0,0 +1,208 @@
+#!/usr/bin/env python
+#
+# test-policies.py - Checks every csim replacement policy (-p) against a
+#     straightforward Python model of the same policy on the bundled
+#     traces. LRU is also checked against csim-ref.
+#
+from __future__ import print_function
+import subprocess
+import re
+import sys
+
+# (s, E, b, trace) configurations, starting with the ones test-csim grades
+CONFIGS = [
+    (1, 1, 1, "traces/yi2.trace"),
+    (4, 2, 4, "traces/yi.trace"),
+    (2, 1, 4, "traces/dave.trace"),
+    (2, 1, 3, "traces/trans.trace"),
+    (2, 2, 3, "traces/trans.trace"),
+    (2, 4, 3, "traces/trans.trace"),
+    (5, 1, 5, "traces/trans.trace"),
+    (1, 8, 3, "traces/trans.trace"),
+    (1, 16, 4, "traces/trans.trace"),
+    (5, 1, 5, "traces/long.trace"),
+    (4, 8, 4, "traces/long.trace"),
+    (0, 16, 4, "traces/trans.trace"),
+    (3, 2, 0, "traces/long.trace"),
+]
+
+POLICIES = ["lru", "fifo", "random", "plru", "srrip", "brrip", "lfu"]
+
+MASK64 = (1 << 64) - 1
+RRPV_MAX = 3
+
+#
+# seed_set - per-set generator seed, splitmix64 of the set index
+#
+def seed_set(set_id):
+    z = ((set_id + 1) * 0x9E3779B97F4A7C15) & MASK64
+    z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & MASK64
+    z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & MASK64
+    z ^= z >> 31
+    return z if z != 0 else 1
+
+#
+# next_random - xorshift64 step, returns (value, new state)
+#
+def next_random(x):
+    x ^= (x << 13) & MASK64
+    x ^= x >> 7
+    x ^= (x << 17) & MASK64
+    return x, x
+
+#
+# Set - one cache set under a given replacement policy
+#
+class Set:
+    def __init__(self, set_id, E, policy):
+        self.E = E
+        self.policy = policy
+        self.tags = [None] * E
+        self.stamps = [0] * E
+        self.uses = [0] * E
+        self.rrpv = [0] * E
+        self.tree = 0
+        self.rng = seed_set(set_id)
+
+    def plru_touch(self, way):
+        node, half = 1, self.E // 2
+        while half >= 1:
+            if way & half:
+                self.tree &= ~(1 << node)
+                node = 2 * node + 1
+            else:
+                self.tree |= 1 << node
+                node = 2 * node
+            half //= 2
+
+    def plru_victim(self):
+        node, half, way = 1, self.E // 2, 0
+        while half >= 1:
+            if self.tree & (1 << node):
+                way |= half
+                node = 2 * node + 1
+            else:
+                node = 2 * node
+            half //= 2
+        return way
+
+    def victim(self):
+        p = self.policy
+        if p in ("lru", "fifo"):
+            return min(range(self.E), key=lambda i: self.stamps[i])
+        if p == "lfu":
+            return min(range(self.E), key=lambda i: (self.uses[i], self.stamps[i]))
+        if p == "random":
+            r, self.rng = next_random(self.rng)
+            return r % self.E
+        if p == "plru":
+            return self.plru_victim()
+        # RRIP: age until some line reaches RRPV_MAX, evict the first one
+        while RRPV_MAX not in self.rrpv:
+            self.rrpv = [v + 1 for v in self.rrpv]
+        return self.rrpv.index(RRPV_MAX)
+
+    # Returns "hit", "miss" or "eviction"
+    def access(self, tag, clock):
+        p = self.policy
+        if tag in self.tags:
+            way = self.tags.index(tag)
+            if p in ("lru", "lfu"):
+                self.stamps[way] = clock
+            if p == "lfu":
+                self.uses[way] += 1
+            if p == "plru":
+                self.plru_touch(way)
+            if p in ("srrip", "brrip"):
+                self.rrpv[way] = 0
+            return "hit"
+
+        result = "miss"
+        if None in self.tags:
+            way = self.tags.index(None)
+        else:
+            way = self.victim()
+            result = "eviction"
+
+        self.tags[way] = tag
+        self.stamps[way] = clock
+        self.uses[way] = 1
+        if p == "plru":
+            self.plru_touch(way)
+        if p == "srrip":
+            self.rrpv[way] = RRPV_MAX - 1
+        if p == "brrip":
+            r, self.rng = next_random(self.rng)
+            self.rrpv[way] = RRPV_MAX - 1 if (r & 31) == 0 else RRPV_MAX
+        return result
+
+#
+# load_trace - list of (op, address) data references
+#
+def load_trace(path):
+    refs = []
+    for line in open(path):
+        m = re.match(r"\s*([LSM])\s+([0-9a-fA-F]+),", line)
+        if m:
+            refs.append((m.group(1), int(m.group(2), 16)))
+    return refs
+
+#
+# model - hits, misses and evictions the reference model predicts
+#
+def model(refs, s, E, b, policy):
+    sets = {}
+    hits = misses = evictions = 0
+    clock = 0
+    for op, address in refs:
+        set_id = (address >> b) & ((1 << s) - 1)
+        tag = address >> (s + b)
+        if set_id not in sets:
+            sets[set_id] = Set(set_id, E, policy)
+        if op == "M":
+            hits += 1
+        clock += 1
+        result = sets[set_id].access(tag, clock)
+        if result == "hit":
+            hits += 1
+        else:
+            misses += 1
+            if result == "eviction":
+                evictions += 1
+    return (hits, misses, evictions)
+
+#
+# run - counts reported by a simulator binary
+#
+def run(cmd):
+    out = subprocess.Popen(cmd, shell=True, stdout=subprocess.PIPE).communicate()[0]
+    m = re.search(r"hits:(\d+) misses:(\d+) evictions:(\d+)", out.decode())
+    return tuple(map(int, m.groups())) if m else None
+
+def main():
+    traces = {}
+    passed = total = 0
+
+    print("%-7s %-10s %-20s %24s %24s" % ("Policy", "(s,E,b)", "Trace", "csim", "Model"))
+    for policy in POLICIES:
+        for s, E, b, path in CONFIGS:
+            if path not in traces:
+                traces[path] = load_trace(path)
+            expected = model(traces[path], s, E, b, policy)
+            actual = run("./csim -p %s -s %d -E %d -b %d -t %s" % (policy, s, E, b, path))
+            ok = actual == expected
+
+            # LRU must also agree with the reference simulator, which needs s >= 1 and b >= 1
+            if policy == "lru" and s > 0 and b > 0:
+                ok = ok and run("./csim-ref -s %d -E %d -b %d -t %s" % (s, E, b, path)) == expected
+
+            total += 1
+            passed += ok
+            print("%-7s %-10s %-20s %24s %24s  %s" % (policy, "(%d,%d,%d)" % (s, E, b), path,
+                                                      actual, expected, "ok" if ok else "FAIL"))
+
+    print("\nTEST_POLICIES_RESULTS=%d/%d" % (passed, total))
+    sys.exit(0 if passed == total else 1)
+
+if __name__ == "__main__":
+    main()
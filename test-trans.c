@@ -2,7 +2,21 @@
  * test-trans.c - Checks the correctness and performance of all of the
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
+ *
+ * Each (function, matrix size) pair is a separate job. With -j, the jobs
+ * run on a pool of forked worker processes, which share nothing but a job
+ * table: every job records and simulates its own trace and writes its
+ * output to its own anonymous temporary file, which is printed in job
+ * order once the pool is done. A forked worker has the same address
+ * layout as the parent, so the traces, and the results, are the same as
+ * in a serial run.
+ *
+ * With -k, the generic kernels registered in kernels.c (double and long
+ * long transposes, matrix multiplies) are evaluated after the transpose
+ * functions, on the same sizes. Their third dimension K is the third
+ * number of an -S size, or M if there is none.
  */
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -11,19 +25,36 @@
 #include <signal.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include "cachelab.h"
+#include "simulator.h"
+#include "tracerec.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
 
 /* Maximum array dimension */
 #define MAXN 256
 
+/* Maximum number of matrix sizes in one run */
+#define MAXSIZES 16
+
+/* Seconds one job may run before test-trans gives up */
+#define JOB_TIMEOUT 120
+
 /* The description string for the transpose_submit() function that the
    student submits for credit */
 #define SUBMIT_DESCRIPTION "Transpose submission"
 
-/* External function defined in trans.c */
+/* External functions defined in trans.c and kernels.c */
 extern void registerFunctions();
+extern void registerKernels();
+
+/* External markers and functions defined in tracegen.c, which is linked
+   in built with -fsanitize=thread so that its accesses can be recorded */
+extern volatile char MARKER_START, MARKER_END;
+extern void tracegen_init(int rows, int cols, int depth);
+extern int tracegen_run(int fn);
+extern int tracegen_regions(int fn, region *regions);
 
 /* External variables defined in cachelab-tools.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
@@ -32,6 +63,77 @@ extern int func_counter;
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int K = 0;
+static int use_valgrind = 0;
+static int use_kernels = 0;
+static int use_regions = 0;
+static int use_classify = 0;
+static int dump_traces = 0;
+
+/* Prefetcher the simulated caches use, from -P */
+static int use_prefetch = 0;
+static prefetch_config prefetch_cfg;
+
+/* Victim or miss cache beside the simulated caches, from -B */
+static int use_victim = 0;
+static victim_config victim_cfg;
+static int workers = 1;
+
+/* Extra cache geometries to evaluate every function on, from -g */
+static geometry *grid = NULL;
+static int num_grid = 0;
+
+/* Matrix sizes to evaluate, from -M/-N and -S */
+struct size {
+    int M;
+    int N;
+    int K;
+};
+static struct size sizes[MAXSIZES];
+static int num_sizes = 0;
+
+/* Job states */
+#define JOB_PENDING 0
+#define JOB_RUNNING 1
+#define JOB_DONE    2
+
+/* Tables printed for the -g geometries: the misses, then with -C the same
+   misses split into compulsory, capacity and conflict misses (see
+   classify.h) */
+#define GRID_TABLES 4
+static const char *grid_titles[GRID_TABLES] = {
+    NULL,
+    "Compulsory misses (on blocks not touched before)",
+    "Capacity misses (also missed by a fully associative LRU cache)",
+    "Conflict misses (hit by a fully associative LRU cache)"
+};
+
+/* One (function, matrix size) pair to evaluate, and its results. Each
+   table's count on each -g geometry goes in arrays shared like the job.
+   The memory the function needs is measured as the bytes in the blocks
+   it touches, which is twice as much for A and B as for an in-place
+   function's one matrix. */
+struct job {
+    int size;
+    int func;
+    int state;
+    int correct;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    unsigned long long compulsory;
+    unsigned long long capacity;
+    unsigned long long conflict;
+    unsigned long long prefetches;
+    unsigned long long prefetch_hits;
+    unsigned long long useless_prefetches;
+    unsigned long long pollution;
+    unsigned long long victim_hits;
+    unsigned long long victim_swaps;
+    unsigned long footprint;
+    unsigned long scratch;
+    unsigned int *grid_counts[GRID_TABLES];
+};
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -39,137 +141,584 @@ struct results {
     int correct;
     int misses;
 };
-static struct results results = {-1, 0, INT_MAX};
 
-/* 
- * eval_perf - Evaluate the performance of the registered transpose functions
+/*
+ * print_results - Emit the results for one matrix size
  */
-void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+static void print_results(struct results *results)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
+    if (results->funcid == -1) {
+        printf("\nError: We could not find your transpose_submit() function\n");
+        printf("Error: Please ensure that description field is exactly \"%s\"\n", 
+               SUBMIT_DESCRIPTION);
+        printf("\nTEST_TRANS_RESULTS=0:0\n");
+    }
+    else {
+        printf("\nSummary for official submission (func %d): correctness=%d misses=%d\n",
+               results->funcid, results->correct, results->misses);
+        printf("\nTEST_TRANS_RESULTS=%d:%d\n", results->correct, results->misses);
+    }
+}
+
+/*
+ * lackey_trace - Runs function i under valgrind and filters its part of
+ *     the lackey trace into trace.f<i>. Returns 0 if the function's
+ *     result was wrong.
+ */
+static int lackey_trace(int i)
+{
+    int flag;
+    unsigned int len;
     unsigned long long int marker_start, marker_end, addr;
     char buf[1000], cmd[255];
     char filename[128];
-
-    registerFunctions(); 
-
-    /* Open the complete trace file */
     FILE* full_trace_fp;  
     FILE* part_trace_fp; 
 
-    /* Evaluate the performance of each registered transpose function */
+    sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -K %d -F %d %s > trace.tmp", M, N, K, i,
+            use_kernels ? "-k" : "");
+    flag=WEXITSTATUS(system(cmd));
+    if (0!=flag) {
+        printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
+        return 0;
+    }
 
-    for (i=0; i<func_counter; i++) {
-        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
-            results.funcid = i; /* remember which function is the submission */
+    /* Get the start and end marker addresses */
+    FILE* marker_fp = fopen(".marker", "r");
+    assert(marker_fp);
+    fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
+    fclose(marker_fp);
 
+    full_trace_fp = fopen("trace.tmp", "r");
+    assert(full_trace_fp);
 
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
+    /* Filtered trace for each transpose function goes in a separate file */
+    sprintf(filename, "trace.f%d", i);
+    part_trace_fp = fopen(filename, "w");
+    assert(part_trace_fp);
+    
+    /* Locate trace corresponding to the trans function */
+    flag = 0;
+    while (fgets(buf, 1000, full_trace_fp) != NULL) {
+
+        /* We are only interested in memory access instructions */
+        if (buf[0]==' ' && buf[2]==' ' &&
+            (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
+            sscanf(buf+3, "%llx,%u", &addr, &len);
+        
+            /* If start marker found, set flag */
+            if (addr == marker_start)
+                flag = 1;
+
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (flag && addr < 0xffffffff) {
+                fputs(buf, part_trace_fp);
+            }
 
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > trace.tmp", M, N,i);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);      
-            continue;
+            /* if end marker found, close trace file */
+            if (addr == marker_end) {
+                flag = 0;
+                fclose(part_trace_fp);
+                break;
+            }
         }
+    }
+    fclose(full_trace_fp);
+    return 1;
+}
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
+/*
+ * record_trace - Runs function i in process, recording every access
+ *     between the markers. With -t, also saves the trace to trace.f<i>
+ *     as lackey would have written it. Returns 0 if the function's
+ *     result was wrong.
+ */
+static int record_trace(int i, trace_ref **refs, int *count)
+{
+    char filename[128];
+    FILE* part_trace_fp;
+    int j, correct;
+
+    tracerec_begin(&MARKER_START, &MARKER_END);
+    correct = tracegen_run(i);
+    *refs = tracerec_end(count);
+    if (!correct) {
+        printf("Validation error at function %d!\nSkipping performance evaluation for this function.\n", i);
+        return 0;
+    }
+    if (!dump_traces)
+        return 1;
+
+    /* Name the trace after the matrix size too when there are several */
+    if (num_sizes > 1 && K != M)
+        sprintf(filename, "trace.f%d.%dx%dx%d", i, M, N, K);
+    else if (num_sizes > 1)
+        sprintf(filename, "trace.f%d.%dx%d", i, M, N);
+    else
+        sprintf(filename, "trace.f%d", i);
+    part_trace_fp = fopen(filename, "w");
+    assert(part_trace_fp);
+    for (j = 0; j < *count; j++) {
+        fprintf(part_trace_fp, " %c %08llx,%d\n", (*refs)[j].op, (*refs)[j].address, (*refs)[j].size);
+    }
+    fclose(part_trace_fp);
+    return 1;
+}
 
+/*
+ * simulate_grid - Counts and classifies the misses of the recorded
+ *     references on every -g geometry
+ */
+static void simulate_grid(struct job *job, trace_ref *refs, int count)
+{
+    static simulator **sims = NULL;
+    cache_performance perf;
+    int g;
+
+    if (!sims) {
+        sims = (simulator **) malloc(sizeof(simulator *) * num_grid);
+        for (g = 0; g < num_grid; g++) {
+            sims[g] = simulator_create(grid[g].s, grid[g].E, grid[g].b, POLICY_LRU);
+            assert(sims[g]);
+            if (use_classify)
+                simulator_classify(sims[g]);
+            if (use_prefetch)
+                simulator_prefetch(sims[g], &prefetch_cfg);
+            if (use_victim)
+                simulator_victim(sims[g], &victim_cfg);
+        }
+    }
 
-        func_list[i].correct=1;
+    for (g = 0; g < num_grid; g++) {
+        simulator_reset(sims[g]);
+        simulator_feed(sims[g], refs, count);
+        simulator_stats(sims[g], &perf);
+        job->grid_counts[0][g] = perf.misses;
+        job->grid_counts[1][g] = perf.compulsory;
+        job->grid_counts[2][g] = perf.capacity;
+        job->grid_counts[3][g] = perf.conflict;
+    }
+}
 
-        /* Save the correctness of the transpose submission */
-        if (results.funcid == i ) {
-            results.correct = 1;
+/*
+ * print_grid - Prints the misses of every function at one matrix size on
+ *     every -g geometry, then with -C their compulsory, capacity and
+ *     conflict parts. Only conflict misses depend on how blocks map to sets.
+ */
+static void print_grid(struct job *jobs, int k)
+{
+    int g, i, table;
+
+    for (table = 0; table < (use_classify ? GRID_TABLES : 1); table++) {
+        if (table == 0 && use_kernels)
+            printf("\nMisses on each cache geometry (M=%d, N=%d, K=%d)\n", sizes[k].M, sizes[k].N, sizes[k].K);
+        else if (table == 0)
+            printf("\nMisses on each cache geometry (M=%d, N=%d)\n", sizes[k].M, sizes[k].N);
+        else
+            printf("\n%s\n", grid_titles[table]);
+        printf("%4s %4s %4s", "s", "E", "b");
+        for (i = 0; i < func_counter; i++)
+            printf("  func %-3d", i);
+        printf("\n");
+        for (g = 0; g < num_grid; g++) {
+            printf("%4d %4d %4d", grid[g].s, grid[g].E, grid[g].b);
+            for (i = 0; i < func_counter; i++) {
+                struct job *job = &jobs[k * func_counter + i];
+                if (job->correct)
+                    printf(" %9u", job->grid_counts[table][g]);
+                else
+                    printf(" %9s", "-");
+            }
+            printf("\n");
         }
+    }
+}
 
-        full_trace_fp = fopen("trace.tmp", "r");
-        assert(full_trace_fp);
+/*
+ * compare_blocks - qsort comparison of two block numbers
+ */
+static int compare_blocks(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a;
+    unsigned long long y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
 
+/*
+ * count_distinct - Sorts the n block numbers and returns how many
+ *     distinct ones there are
+ */
+static unsigned long count_distinct(unsigned long long *blocks, int n)
+{
+    unsigned long distinct = 0;
+    int j;
+
+    qsort(blocks, n, sizeof(unsigned long long), compare_blocks);
+    for (j = 0; j < n; j++)
+        if (j == 0 || blocks[j] != blocks[j - 1])
+            distinct++;
+    return distinct;
+}
 
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-    
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-        
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
+/*
+ * count_blocks - Returns the number of distinct 2^b byte blocks the
+ *     recorded references touch
+ */
+static unsigned long count_blocks(trace_ref *refs, int count, unsigned int b)
+{
+    unsigned long long *blocks;
+    unsigned long distinct;
+    int j;
+
+    if (count == 0)
+        return 0;
+    blocks = (unsigned long long *) malloc(sizeof(unsigned long long) * count);
+    for (j = 0; j < count; j++)
+        blocks[j] = refs[j].address >> b;
+    distinct = count_distinct(blocks, count);
+    free(blocks);
+    return distinct;
+}
 
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
-            }
-        }
-        fclose(full_trace_fp);
+/*
+ * count_scratch - Returns the number of distinct 2^b byte blocks the
+ *     function stores to outside the regions, which is scratch memory
+ *     of its own. Loads are left out, since tracegen still loads its
+ *     globals after the start marker, and so are the first and last
+ *     references, the stores to the markers.
+ */
+static unsigned long count_scratch(trace_ref *refs, int count, unsigned int b,
+                                   region *regions, int num_regions)
+{
+    unsigned long long *blocks;
+    unsigned long distinct;
+    int j, r, n = 0;
+
+    if (count == 0)
+        return 0;
+    blocks = (unsigned long long *) malloc(sizeof(unsigned long long) * count);
+    for (j = 1; j < count - 1; j++) {
+        if (refs[j].op == 'L')
+            continue;
+        for (r = 0; r < num_regions; r++)
+            if (refs[j].address >= regions[r].start &&
+                refs[j].address < regions[r].end)
+                break;
+        if (r == num_regions)
+            blocks[n++] = refs[j].address >> b;
+    }
+    distinct = count_distinct(blocks, n);
+    free(blocks);
+    return distinct;
+}
+
+/*
+ * run_job - Validates one function at one matrix size and evaluates its
+ *     performance (s, E, b), printing its progress to stdout
+ */
+static void run_job(struct job *job, unsigned int s, unsigned int E, unsigned int b)
+{
+    static int current_size = -1;
+    static simulator *sim = NULL;
+    int i = job->func, count = 0;
+    trace_ref *refs = NULL;
+    cache_performance perf;
+    region regions[MAX_REGIONS];
+    int num_regions;
+
+    /* Fill A for this job's size, unless the last job had the same size */
+    M = sizes[job->size].M;
+    N = sizes[job->size].N;
+    K = sizes[job->size].K;
+    if (!use_valgrind && job->size != current_size) {
+        tracegen_init(M, N, K);
+        current_size = job->size;
+    }
 
+    printf("\nFunction %d (%d total)\n",i,func_counter);
+    if (func_list[i].square_only && M != N) {
+        printf("Skipping function %d, which only transposes square matrices\n", i);
+        job->state = JOB_DONE;
+        return;
+    }
+    printf("Step 1: Validating and generating memory traces\n");
+    /* Record the trace in process, or use valgrind to generate it */
+    if (use_valgrind ? !lackey_trace(i) : !record_trace(i, &refs, &count)) {
+        job->state = JOB_DONE;
+        return;
+    }
+    job->correct = 1;
+
+    printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
+    if (use_valgrind) {
         /* Run the reference simulator */
-        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
         char cmd[255];
         sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null", 
                 s, E, b, i);
         system(cmd);
-    
+
         /* Collect results from the reference simulator */
         FILE* in_fp = fopen(".csim_results","r");
         assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
+        fscanf(in_fp, "%u %u %u", &job->hits, &job->misses, &job->evictions);
         fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
-        printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
-    
-        /* If it is transpose_submit(), record number of misses */
-        if (results.funcid == i) {
-            results.misses = misses;
+    } else {
+        /* Run the recorded references through the simulator library */
+        if (!sim) {
+            sim = simulator_create(s, E, b, POLICY_LRU);
+            assert(sim);
+            if (use_classify)
+                simulator_classify(sim);
+            if (use_prefetch)
+                simulator_prefetch(sim, &prefetch_cfg);
+            if (use_victim)
+                simulator_victim(sim, &victim_cfg);
         }
+        num_regions = tracegen_regions(i, regions);
+        if (use_regions)
+            simulator_regions(sim, regions, num_regions);
+        simulator_reset(sim);
+        simulator_feed(sim, refs, count);
+        simulator_stats(sim, &perf);
+        job->hits = perf.hits;
+        job->misses = perf.misses;
+        job->evictions = perf.evictions;
+        job->compulsory = perf.compulsory;
+        job->capacity = perf.capacity;
+        job->conflict = perf.conflict;
+        job->prefetches = perf.prefetches;
+        job->prefetch_hits = perf.prefetch_hits;
+        job->useless_prefetches = perf.useless_prefetches;
+        job->pollution = perf.pollution;
+        job->victim_hits = perf.victim_hits;
+        job->victim_swaps = perf.victim_swaps;
+
+        job->footprint = count_blocks(refs, count, b) << b;
+        job->scratch = count_scratch(refs, count, b, regions, num_regions) << b;
     }
-  
+    printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
+           i, func_list[i].description, job->hits, job->misses, job->evictions);
+    if (!use_valgrind) {
+        if (use_classify)
+            printf("func %u 3C: compulsory:%llu, capacity:%llu, conflict:%llu\n",
+                   i, job->compulsory, job->capacity, job->conflict);
+        if (use_prefetch)
+            printf("func %u prefetch: prefetches:%llu, prefetch hits:%llu, useless:%llu, pollution:%llu\n",
+                   i, job->prefetches, job->prefetch_hits, job->useless_prefetches, job->pollution);
+        if (use_victim && victim_cfg.kind == VICTIM_CACHE)
+            printf("func %u victim cache: hits:%llu, swaps:%llu\n",
+                   i, job->victim_hits, job->victim_swaps);
+        else if (use_victim)
+            printf("func %u miss cache: hits:%llu\n", i, job->victim_hits);
+        printf("func %u memory: %lu bytes touched", i, job->footprint);
+        if (job->scratch > 0)
+            printf(" (%s%lu bytes of them scratch)",
+                   func_list[i].inplace_ptr ? "one matrix, " : "", job->scratch);
+        else if (func_list[i].inplace_ptr)
+            printf(" (in place)");
+        printf("\n");
+        if (use_regions) {
+            printf("func %u counts by region:\n", i);
+            region_map_print(sim->regions, use_classify);
+        }
+    }
+
+    if (num_grid > 0) {
+        printf("Step 3: Evaluating performance on %d more cache geometries\n", num_grid);
+        simulate_grid(job, refs, count);
+    }
+    job->state = JOB_DONE;
+}
+
+/*
+ * run_pool - Runs every job on a pool of forked workers. Each worker
+ *     takes the next pending job from the shared table until none are
+ *     left, sending the job's output to outputs[job]. Each job has its
+ *     own JOB_TIMEOUT; the parent only waits, so it never times out
+ *     while workers are still running.
+ */
+static void run_pool(struct job *jobs, int num_jobs, FILE **outputs,
+                     unsigned int s, unsigned int E, unsigned int b)
+{
+    int *next = (int *) (jobs + num_jobs);
+    int w, j;
+
+    /* Don't let the workers inherit unflushed output */
+    fflush(stdout);
+
+    for (w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Unable to fork worker\n");
+            exit(1);
+        }
+        if (pid == 0) {
+            while ((j = __sync_fetch_and_add(next, 1)) < num_jobs) {
+                dup2(fileno(outputs[j]), STDOUT_FILENO);
+                jobs[j].state = JOB_RUNNING;
+                alarm(JOB_TIMEOUT);
+                run_job(&jobs[j], s, E, b);
+                fflush(stdout);
+            }
+            _exit(0);
+        }
+    }
+    while (wait(NULL) > 0)
+        ;
+}
+
+/*
+ * print_output - Copies a job's output to stdout
+ */
+static void print_output(FILE *output)
+{
+    char buf[1000];
+    size_t len;
+
+    rewind(output);
+    while ((len = fread(buf, 1, sizeof(buf), output)) > 0)
+        fwrite(buf, 1, len, stdout);
+    fclose(output);
+}
+
+/* 
+ * eval_perf - Evaluate the performance of the registered transpose
+ *     functions at every matrix size, and print the results for the
+ *     submission at each size
+ */
+void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+{
+    int i, k, t, num_jobs;
+    size_t shared_size;
+    struct job *jobs;
+    unsigned int *grid_results;
+    FILE **outputs = NULL;
+
+    registerFunctions(); 
+    if (use_kernels)
+        registerKernels();
+
+    /* The job table is shared with the workers, followed by the index of
+       the next pending job and then the jobs' -g results */
+    num_jobs = num_sizes * func_counter;
+    shared_size = sizeof(struct job) * num_jobs + sizeof(int) +
+        sizeof(unsigned int) * GRID_TABLES * num_jobs * num_grid;
+    jobs = (struct job *) mmap(NULL, shared_size,
+                               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(jobs != MAP_FAILED);
+    grid_results = (unsigned int *) ((int *) (jobs + num_jobs) + 1);
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].size = i / func_counter;
+        jobs[i].func = i % func_counter;
+        for (t = 0; t < GRID_TABLES; t++)
+            jobs[i].grid_counts[t] = grid_results + (GRID_TABLES * i + t) * num_grid;
+    }
+
+    if (workers > 1) {
+        outputs = (FILE **) malloc(sizeof(FILE *) * num_jobs);
+        for (i = 0; i < num_jobs; i++) {
+            outputs[i] = tmpfile();
+            assert(outputs[i]);
+        }
+        run_pool(jobs, num_jobs, outputs, s, E, b);
+    }
+
+    /* Evaluate the performance of each registered transpose function */
+
+    for (k = 0; k < num_sizes; k++) {
+        struct results results = {-1, 0, INT_MAX};
+
+        if (num_sizes > 1 && sizes[k].K != sizes[k].M)
+            printf("\nMatrix %dx%dx%d\n", sizes[k].M, sizes[k].N, sizes[k].K);
+        else if (num_sizes > 1)
+            printf("\nMatrix %dx%d\n", sizes[k].M, sizes[k].N);
+
+        for (i=0; i<func_counter; i++) {
+            struct job *job = &jobs[k * func_counter + i];
+
+            if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
+                results.funcid = i; /* remember which function is the submission */
+
+            if (workers > 1) {
+                print_output(outputs[k * func_counter + i]);
+
+                /* A worker that died running the job has already
+                   reported why */
+                if (job->state != JOB_DONE) {
+                    fflush(stdout);
+                    exit(1);
+                }
+            } else {
+                alarm(JOB_TIMEOUT);
+                run_job(job, s, E, b);
+                alarm(0);
+            }
+
+            func_list[i].correct = job->correct;
+            if (!job->correct)
+                continue;
+
+            func_list[i].num_hits = job->hits;
+            func_list[i].num_misses = job->misses;
+            func_list[i].num_evictions = job->evictions;
+
+            /* Save the correctness and misses of the transpose submission */
+            if (results.funcid == i ) {
+                results.correct = 1;
+                results.misses = job->misses;
+            }
+        }
+
+        if (num_grid > 0)
+            print_grid(jobs, k);
+        print_results(&results);
+    }
+
+    free(outputs);
+    munmap(jobs, shared_size);
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hkrCtV] [-j <workers>] [-g <geoms>] [-P <prefetcher>] [-B <buffer>] -M <rows> -N <cols> | -S <rows>x<cols>[x<depth>][,...]\n",
+           argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -k          Also evaluate the generic kernels in kernels.c\n");
+    printf("  -r          Break each function's counts down by matrix and stack, and\n");
+    printf("              count which of them evicted which in each set (not with -V)\n");
+    printf("  -C          Split the misses into compulsory, capacity and conflict\n");
+    printf("              misses (not with -V; see classify.h)\n");
+    printf("  -t          Also write each function's trace to trace.f<i> (with -S,\n");
+    printf("              trace.f<i>.<M>x<N>), as valgrind's lackey would\n");
+    printf("  -V          Trace with valgrind instead of recording in process.\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
+    printf("  -S <sizes>  Comma separated matrix sizes to evaluate in one run (max %d);\n", MAXSIZES);
+    printf("              a third number is the kernels' K, which is M otherwise\n");
+    printf("  -j <n>      Evaluate the functions on n worker processes\n");
+    printf("  -g <geoms>  Also count misses on each s:E:b cache geometry in a comma\n");
+    printf("              separated list, where s, E and b may be ranges such as 1-8\n");
+    printf("  -P <pf>     Simulate a prefetcher, next|stride|stream[:degree[:entries]],\n");
+    printf("              on every cache (not with -r or -V; see prefetch.h)\n");
+    printf("  -B <buf>    Put a victim|miss[:entries] cache beside every cache and count\n");
+    printf("              the misses it serves (not with -r, -V or -P; see victim.h)\n");
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
+    printf("Example: %s -j 4 -S 32x32,64x64,61x67\n", argv[0]);
+    printf("Example: %s -M 61 -N 67 -C -g 3-7:1-4:4-6\n", argv[0]);
+    printf("Example: %s -k -S 32x32,48x40x24\n", argv[0]);
+    printf("Example: %s -M 64 -N 64 -P stream\n", argv[0]);
+    printf("Example: %s -M 32 -N 32 -B victim:8\n", argv[0]);
 }
 
 /*
@@ -198,8 +747,10 @@ void sigalrm_handler(int signum){
 int main(int argc, char* argv[])
 {
     char c;
+    char *p;
+    int k;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:S:j:g:P:B:hkrCtV")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +758,66 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'S':
+            for (p = optarg; *p; p++) {
+                int fields;
+                if (num_sizes == MAXSIZES ||
+                    (fields = sscanf(p, "%dx%dx%d", &sizes[num_sizes].M, &sizes[num_sizes].N,
+                                     &sizes[num_sizes].K)) < 2) {
+                    printf("Error: Invalid matrix sizes \"%s\"\n", optarg);
+                    usage(argv);
+                    exit(1);
+                }
+                if (fields == 2)
+                    sizes[num_sizes].K = sizes[num_sizes].M;
+                num_sizes++;
+                if (!(p = strchr(p, ',')))
+                    break;
+            }
+            break;
+        case 'g':
+            if (!parse_geometries(optarg, &grid, &num_grid)) {
+                printf("Error: Invalid geometry list \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            if (workers < 1)
+                workers = 1;
+            break;
+        case 'k':
+            use_kernels = 1;
+            break;
+        case 'r':
+            use_regions = 1;
+            break;
+        case 'C':
+            use_classify = 1;
+            break;
+        case 't':
+            dump_traces = 1;
+            break;
+        case 'P':
+            if (!parse_prefetcher(optarg, &prefetch_cfg)) {
+                printf("Error: Invalid prefetcher \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            use_prefetch = 1;
+            break;
+        case 'B':
+            if (!parse_victim_buffer(optarg, &victim_cfg)) {
+                printf("Error: Invalid victim buffer \"%s\"\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            use_victim = 1;
+            break;
+        case 'V':
+            use_valgrind = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -216,14 +827,65 @@ int main(int argc, char* argv[])
         }
     }
   
-    if (M == 0 || N == 0) {
+    /* -M and -N give one more size */
+    if (M != 0 || N != 0) {
+        if (num_sizes == MAXSIZES) {
+            printf("Error: More than %d matrix sizes\n", MAXSIZES);
+            usage(argv);
+            exit(1);
+        }
+        sizes[num_sizes].M = M;
+        sizes[num_sizes].N = N;
+        sizes[num_sizes].K = M;
+        num_sizes++;
+    }
+
+    if (num_sizes == 0) {
         printf("Error: Missing required argument\n");
         usage(argv);
         exit(1);
     }
 
-    if (M > MAXN || N > MAXN) {
-        printf("Error: M or N exceeds %d\n", MAXN);
+    for (k = 0; k < num_sizes; k++) {
+        if (sizes[k].M <= 0 || sizes[k].N <= 0 || sizes[k].K <= 0) {
+            printf("Error: Missing required argument\n");
+            usage(argv);
+            exit(1);
+        }
+        if (sizes[k].M > MAXN || sizes[k].N > MAXN || sizes[k].K > MAXN) {
+            printf("Error: M, N or K exceeds %d\n", MAXN);
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    /* The valgrind path goes through fixed file names, so it can only
+       run one job at a time */
+    if (use_valgrind && (num_sizes > 1 || workers > 1 || num_grid > 0)) {
+        printf("Error: -V evaluates one matrix size without workers or -g\n");
+        usage(argv);
+        exit(1);
+    }
+    if (use_valgrind && use_classify) {
+        printf("Error: -C cannot be combined with -V\n");
+        usage(argv);
+        exit(1);
+    }
+    if (use_valgrind && use_regions) {
+        printf("Error: -r cannot be combined with -V\n");
+        usage(argv);
+        exit(1);
+    }
+
+    /* Prefetching, victim buffers and regions are simulated on separate
+       paths, and csim-ref does none of them */
+    if (use_prefetch && (use_regions || use_valgrind)) {
+        printf("Error: -P cannot be combined with -r or -V\n");
+        usage(argv);
+        exit(1);
+    }
+    if (use_victim && (use_regions || use_valgrind || use_prefetch)) {
+        printf("Error: -B cannot be combined with -r, -V or -P\n");
         usage(argv);
         exit(1);
     }
@@ -239,23 +901,8 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    /* Time out and give up after a while */
-    alarm(120);
-
-    /* Check the performance of the student's transpose function */
+    /* Check the performance of the student's transpose function, and
+       emit the results for each matrix size */
     eval_perf(5, 1, 5);
-  
-    /* Emit the results for this particular test */
-    if (results.funcid == -1) {
-        printf("\nError: We could not find your transpose_submit() function\n");
-        printf("Error: Please ensure that description field is exactly \"%s\"\n", 
-               SUBMIT_DESCRIPTION);
-        printf("\nTEST_TRANS_RESULTS=0:0\n");
-    }
-    else {
-        printf("\nSummary for official submission (func %d): correctness=%d misses=%d\n",
-               results.funcid, results.correct, results.misses);
-        printf("\nTEST_TRANS_RESULTS=%d:%d\n", results.correct, results.misses);
-    }
     return 0;
 }
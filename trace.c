@@ -0,0 +1,525 @@
+/*
+ * trace.c - Trace input layer for csim
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Size of the buffer used when the trace cannot be mapped */
+#define STREAM_BUF_SIZE (1 << 20)
+
+/* Record count stored in the header of a binary trace whose length was not known when it was written */
+#define TRACE_COUNT_UNKNOWN (~0ULL)
+
+//Value of each hex digit plus one, so that every other character maps to 0 and ends the number
+static const unsigned char hex_digit[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+//Binary op codes are indexes into this string
+static const char op_chars[] = "LSMI";
+
+/**
+ * Checks for a binary trace header at the start of data and, if there is one, switches the reader to binary mode.
+ * @param reader reader to configure
+ * @param data first bytes of the trace
+ * @param len number of bytes available at data
+ * @return 1 if the header was found, 0 if the trace should be parsed as text
+ */
+static int trace_detect(trace_reader *reader, const char *data, size_t len) {
+    if(len < TRACE_HEADER_SIZE || memcmp(data, TRACE_MAGIC, 4) != 0) {
+        reader->format = TRACE_TEXT;
+        return 0;
+    }
+
+    const unsigned char *header = (const unsigned char *) data;
+    reader->format = TRACE_BINARY;
+    reader->remaining = 0;
+    for(int i = 7; i >= 0; i--) {
+        reader->remaining = (reader->remaining << 8) | header[8 + i];
+    }
+    reader->prev_address[0] = 0;
+    reader->prev_address[1] = 0;
+    return 1;
+}
+
+/**
+ * Slides whatever has not been decoded yet to the front of the streaming buffer and reads until the buffer is full
+ * or the input ends.
+ * @param reader streaming reader to refill
+ */
+static void trace_fill(trace_reader *reader) {
+    size_t leftover = (reader->buf + reader->buf_len) - reader->pos;
+    memmove(reader->buf, reader->pos, leftover);
+    reader->buf_len = leftover;
+    reader->pos = reader->buf;
+
+    while(!reader->eof && reader->buf_len < STREAM_BUF_SIZE) {
+        ssize_t got = read(reader->fd, reader->buf + reader->buf_len, STREAM_BUF_SIZE - reader->buf_len);
+        if(got <= 0) {
+            reader->eof = 1;
+        } else {
+            reader->buf_len += got;
+        }
+    }
+}
+
+/**
+ * Sets end for a freshly filled streaming buffer. Text stops after the last complete line. Binary stops
+ * TRACE_MAX_RECORD bytes short of the data so a record is never cut off, except at the end of the input where the
+ * buffer is zero padded instead.
+ * @param reader streaming reader to update
+ */
+static void trace_set_stream_end(trace_reader *reader) {
+    if(reader->format == TRACE_BINARY) {
+        if(reader->eof) {
+            memset(reader->buf + reader->buf_len, 0, TRACE_MAX_RECORD);
+            reader->end = reader->buf + reader->buf_len;
+        } else {
+            reader->end = reader->buf + reader->buf_len - TRACE_MAX_RECORD;
+        }
+        return;
+    }
+
+    if(reader->eof && reader->buf_len > 0 && reader->buf[reader->buf_len - 1] != '\n') {
+        reader->buf[reader->buf_len++] = '\n';
+    }
+
+    //Find the end of the last complete line
+    char *end = reader->buf + reader->buf_len;
+    while(end > reader->pos && end[-1] != '\n') {
+        end--;
+    }
+
+    //A single line longer than the whole buffer cannot be a trace record, so drop it
+    if(end == reader->pos && reader->buf_len == STREAM_BUF_SIZE) {
+        reader->buf_len = 0;
+        reader->pos = reader->buf;
+        end = reader->buf;
+    }
+
+    reader->end = end;
+}
+
+/**
+ * Opens a trace for reading. Regular files are mapped into memory; anything else (including "-" for stdin) falls
+ * back to reading through a streaming buffer. Binary traces are recognized by their header, anything else is
+ * parsed as lackey text.
+ * @param path path of the trace file, or "-" for stdin
+ * @return the new reader, or NULL if the file could not be opened
+ */
+trace_reader *trace_open(const char *path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    trace_reader *reader = (trace_reader *) calloc(1, sizeof(trace_reader));
+    reader->fd = fd;
+
+    //Try to map regular, non-empty files
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            reader->map = map;
+            reader->map_len = st.st_size;
+            reader->data = (const char *) map;
+            reader->pos = reader->data;
+
+            const char *map_end = reader->data + reader->map_len;
+            const char *end = map_end;
+            if(trace_detect(reader, reader->data, reader->map_len)) {
+                //Records that could run off the end of the mapping are decoded from the padded tail copy instead
+                reader->pos += TRACE_HEADER_SIZE;
+                end = map_end - TRACE_MAX_RECORD;
+                if(end < reader->pos) {
+                    end = reader->pos;
+                }
+            } else {
+                //Only hand whole lines to the parser. A final line without a newline is copied into tail.
+                while(end > reader->data && end[-1] != '\n') {
+                    end--;
+                }
+            }
+
+            reader->tail_len = map_end - end;
+            if(reader->tail_len > sizeof(reader->tail) - TRACE_MAX_RECORD) {
+                reader->tail_len = sizeof(reader->tail) - TRACE_MAX_RECORD;
+            }
+            memcpy(reader->tail, end, reader->tail_len);
+            if(reader->format == TRACE_TEXT && reader->tail_len > 0) {
+                reader->tail[reader->tail_len++] = '\n';
+            }
+
+            reader->end = end;
+            return reader;
+        }
+    }
+
+    //Streaming fallback. The spare bytes let a final unterminated line get a newline, or binary data get padding.
+    reader->buf = (char *) malloc(STREAM_BUF_SIZE + TRACE_MAX_RECORD);
+    reader->data = reader->buf;
+    reader->pos = reader->buf;
+    trace_fill(reader);
+    if(trace_detect(reader, reader->buf, reader->buf_len)) {
+        reader->pos += TRACE_HEADER_SIZE;
+    }
+    trace_set_stream_end(reader);
+    return reader;
+}
+
+/**
+ * Makes more data available to the decoder once it has run out of room between pos and end.
+ * @param reader reader to advance
+ * @return 1 if there is new data to decode, 0 at the end of the trace
+ */
+static int trace_advance(trace_reader *reader) {
+    if(reader->buf == NULL) {
+        //A mapped file only has the copied tail left to give out. A binary record may already have run past end
+        //    into the bytes that were copied, so keep the same offset.
+        if(reader->data == reader->tail || reader->tail_len == 0) {
+            return 0;
+        }
+        size_t offset = reader->pos - reader->end;
+        reader->data = reader->tail;
+        reader->pos = reader->tail + offset;
+        reader->end = reader->tail + reader->tail_len;
+        return reader->pos < reader->end;
+    }
+
+    if(reader->eof) {
+        return 0;
+    }
+    trace_fill(reader);
+    trace_set_stream_end(reader);
+    return reader->pos < reader->end;
+}
+
+/**
+ * Decodes up to max_refs records from the lines between pos and end. Every line in that range ends with '\n', which
+ * stops each of the scanning loops, so none of them need bounds checks. Lines that are not "op addr,size" records
+ * (valgrind banners, blank lines) are skipped.
+ * @param reader reader to parse from
+ * @param refs array to fill with decoded records
+ * @param max_refs capacity of refs
+ * @return number of records decoded
+ */
+static int trace_parse(trace_reader *reader, trace_ref *refs, int max_refs) {
+    const char *p = reader->pos;
+    const char *end = reader->end;
+    int count = 0;
+
+    while(count < max_refs && p < end) {
+        while(*p == ' ' || *p == '\t') {
+            p++;
+        }
+
+        char op = *p;
+        if(op == 'L' || op == 'S' || op == 'M' || op == 'I') {
+            p++;
+            while(*p == ' ') {
+                p++;
+            }
+
+            unsigned long long address = 0;
+            unsigned int digit;
+            while((digit = hex_digit[(unsigned char) *p]) != 0) {
+                address = (address << 4) | (digit - 1);
+                p++;
+            }
+
+            if(*p == ',') {
+                p++;
+                int size = 0;
+                while((unsigned) (*p - '0') < 10) {
+                    size = size * 10 + (*p - '0');
+                    p++;
+                }
+
+                refs[count].address = address;
+                refs[count].size = size;
+                refs[count].op = op;
+                count++;
+            }
+        }
+
+        //Move past the rest of the line
+        p = (const char *) memchr(p, '\n', end - p) + 1;
+    }
+
+    reader->pos = p;
+    return count;
+}
+
+/**
+ * Reads one varint. The caller guarantees at least TRACE_MAX_RECORD readable bytes, so the loop gives up after 10
+ * bytes rather than checking bounds.
+ * @param p cursor to read from, advanced past the varint
+ * @return decoded value
+ */
+static inline unsigned long long read_varint(const unsigned char **p) {
+    const unsigned char *q = *p;
+    unsigned long long value = *q & 0x7f;
+    int shift = 7;
+    while((*q++ & 0x80) && shift < 64) {
+        value |= (unsigned long long) (*q & 0x7f) << shift;
+        shift += 7;
+    }
+    *p = q;
+    return value;
+}
+
+/**
+ * Decodes up to max_refs binary records starting before end. Each one may extend up to TRACE_MAX_RECORD bytes past
+ * end, which is always readable.
+ * @param reader reader to decode from
+ * @param refs array to fill with decoded records
+ * @param max_refs capacity of refs
+ * @return number of records decoded
+ */
+static int trace_decode(trace_reader *reader, trace_ref *refs, int max_refs) {
+    const unsigned char *p = (const unsigned char *) reader->pos;
+    const unsigned char *end = (const unsigned char *) reader->end;
+    int count = 0;
+
+    if((unsigned long long) max_refs > reader->remaining) {
+        max_refs = (int) reader->remaining;
+    }
+
+    while(count < max_refs && p < end) {
+        unsigned int head = *p++;
+        unsigned int op = head & 3;
+        unsigned int size = head >> 2;
+        if(size == 63) {
+            size = (unsigned int) read_varint(&p);
+        }
+
+        //Undo the zigzag encoding, then the delta against the previous address of the same kind
+        unsigned long long zigzag = read_varint(&p);
+        int kind = op == 3;
+        unsigned long long address = reader->prev_address[kind] + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+        reader->prev_address[kind] = address;
+
+        refs[count].address = address;
+        refs[count].size = (int) size;
+        refs[count].op = op_chars[op];
+        count++;
+    }
+
+    if(reader->remaining != TRACE_COUNT_UNKNOWN) {
+        reader->remaining -= count;
+    }
+    reader->pos = (const char *) p;
+    return count;
+}
+
+/**
+ * Fills refs with the next batch of records from the trace.
+ * @param reader reader to pull records from
+ * @param refs array to fill with decoded records
+ * @param max_refs capacity of refs
+ * @return number of records decoded, 0 once the trace is exhausted
+ */
+int trace_read_batch(trace_reader *reader, trace_ref *refs, int max_refs) {
+    int count = 0;
+    while(count < max_refs) {
+        if(reader->format == TRACE_BINARY) {
+            count += trace_decode(reader, refs + count, max_refs - count);
+            if(reader->remaining == 0) {
+                break;
+            }
+        } else {
+            count += trace_parse(reader, refs + count, max_refs - count);
+        }
+
+        if(count < max_refs && !trace_advance(reader)) {
+            break;
+        }
+    }
+    return count;
+}
+
+/**
+ * Unmaps or frees the trace buffer and closes the underlying file.
+ * @param reader reader to close
+ */
+void trace_close(trace_reader *reader) {
+    if(reader->map != NULL) {
+        munmap(reader->map, reader->map_len);
+    }
+    if(reader->fd != STDIN_FILENO) {
+        close(reader->fd);
+    }
+    free(reader->buf);
+    free(reader);
+}
+
+/**
+ * Returns how many blocks a reference touches.
+ * @param ref reference to look at
+ * @param bbits number of block offset bits
+ * @return 1, or more if the reference crosses a block boundary
+ */
+static inline int blocks_touched(const trace_ref *ref, int bbits) {
+    if(ref->size <= 1) {
+        return 1;
+    }
+    return (int) (((ref->address + (unsigned long long) ref->size - 1) >> bbits) - (ref->address >> bbits)) + 1;
+}
+
+/**
+ * Splits every reference that crosses a block boundary into one reference per block it touches, each covering only
+ * its own bytes. References that fit in one block are copied unchanged, and the order is kept.
+ * @param refs references to split
+ * @param count number of references
+ * @param bbits number of block offset bits
+ * @param out buffer for the split references, grown as needed (may start out NULL)
+ * @param out_size capacity of *out, updated
+ * @return number of references in *out
+ */
+int trace_split_batch(const trace_ref *refs, int count, int bbits, trace_ref **out, int *out_size) {
+    //Count first so the buffer grows at most once per batch
+    int total = 0;
+    for(int i = 0; i < count; i++) {
+        total += blocks_touched(&refs[i], bbits);
+    }
+    if(total > *out_size) {
+        *out = (trace_ref *) realloc(*out, sizeof(trace_ref) * total);
+        *out_size = total;
+    }
+
+    int n = 0;
+    for(int i = 0; i < count; i++) {
+        int blocks = blocks_touched(&refs[i], bbits);
+        if(blocks == 1) {
+            (*out)[n++] = refs[i];
+            continue;
+        }
+
+        unsigned long long address = refs[i].address;
+        unsigned long long end = address + (unsigned long long) refs[i].size;
+        for(int j = 0; j < blocks; j++) {
+            unsigned long long next = ((address >> bbits) + 1) << bbits;
+            if(j == blocks - 1) {
+                next = end;
+            }
+            (*out)[n].address = address;
+            (*out)[n].size = (int) (next - address);
+            (*out)[n].op = refs[i].op;
+            n++;
+            address = next;
+        }
+    }
+    return n;
+}
+
+/**
+ * Writes value as a varint.
+ * @param out buffer to write to, with room for 10 bytes
+ * @param value value to encode
+ * @return number of bytes written
+ */
+static int write_varint(unsigned char *out, unsigned long long value) {
+    int len = 0;
+    while(value >= 0x80) {
+        out[len++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (unsigned char) value;
+    return len;
+}
+
+/**
+ * Writes the 16-byte binary trace header.
+ * @param file stream to write to
+ * @param count record count to store
+ */
+static void write_header(FILE *file, unsigned long long count) {
+    unsigned char header[TRACE_HEADER_SIZE] = {0};
+    memcpy(header, TRACE_MAGIC, 4);
+    header[4] = TRACE_VERSION;
+    for(int i = 0; i < 8; i++) {
+        header[8 + i] = (unsigned char) (count >> (8 * i));
+    }
+    fwrite(header, 1, TRACE_HEADER_SIZE, file);
+}
+
+/**
+ * Creates a binary trace. The record count in the header is filled in by trace_writer_close when the output is
+ * seekable; otherwise it is left as "until end of file".
+ * @param path file to create, or "-" for stdout
+ * @return the new writer, or NULL if the file could not be created
+ */
+trace_writer *trace_writer_open(const char *path) {
+    FILE *file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if(file == NULL) {
+        return NULL;
+    }
+
+    trace_writer *writer = (trace_writer *) calloc(1, sizeof(trace_writer));
+    writer->file = file;
+    write_header(file, TRACE_COUNT_UNKNOWN);
+    return writer;
+}
+
+/**
+ * Appends records to a binary trace.
+ * @param writer trace to append to
+ * @param refs records to encode
+ * @param count number of records
+ */
+void trace_write_batch(trace_writer *writer, const trace_ref *refs, int count) {
+    unsigned char out[TRACE_BATCH * TRACE_MAX_RECORD];
+    int len = 0;
+
+    for(int i = 0; i < count; i++) {
+        unsigned int op = (unsigned int) (strchr(op_chars, refs[i].op) - op_chars);
+        unsigned int size = (unsigned int) refs[i].size;
+        int kind = op == 3;
+
+        out[len++] = (unsigned char) (op | (size < 63 ? size : 63) << 2);
+        if(size >= 63) {
+            len += write_varint(out + len, size);
+        }
+
+        unsigned long long delta = refs[i].address - writer->prev_address[kind];
+        len += write_varint(out + len, (delta << 1) ^ (0 - (delta >> 63)));
+        writer->prev_address[kind] = refs[i].address;
+
+        //Flush whenever the buffer could not hold another record
+        if(len > (int) sizeof(out) - TRACE_MAX_RECORD) {
+            fwrite(out, 1, len, writer->file);
+            len = 0;
+        }
+    }
+
+    fwrite(out, 1, len, writer->file);
+    writer->count += count;
+}
+
+/**
+ * Finishes a binary trace, recording the final record count in its header when possible.
+ * @param writer trace to close
+ */
+void trace_writer_close(trace_writer *writer) {
+    if(fseek(writer->file, 0, SEEK_SET) == 0) {
+        write_header(writer->file, writer->count);
+    }
+    if(writer->file != stdout) {
+        fclose(writer->file);
+    } else {
+        fflush(stdout);
+    }
+    free(writer);
+}
@@ -0,0 +1,113 @@
+/*
+ * trace.h - Trace input layer for csim
+ *
+ * Decodes valgrind lackey output (" L 0038b0a0,8") into batches of
+ * trace_ref records. Regular files are memory-mapped and parsed in place;
+ * pipes and stdin ("-") are read through a fixed streaming buffer.
+ *
+ * Traces can also be stored in a compact binary format, which trace_open
+ * recognizes by its magic number. A binary trace is a 16-byte header
+ * (the 4 bytes "CTRC", a 32-bit version and a 64-bit record count, both
+ * little-endian; a count of all ones means "until end of file") followed
+ * by one variable-length record per reference:
+ *
+ *   byte 0   op in bits 0-1 (L, S, M, I), size in bits 2-7; a size of 63
+ *            or more is stored as 63 and followed by a varint holding the
+ *            real size
+ *   varint   zigzag-encoded difference from the previous address of the
+ *            same kind (instruction fetches and data accesses are tracked
+ *            separately)
+ *
+ * Varints are little-endian base-128 with the high bit of each byte set
+ * when another byte follows.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Number of references csim asks for per call to trace_read_batch */
+#define TRACE_BATCH 4096
+
+/* Binary trace header */
+#define TRACE_MAGIC "CTRC"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+
+/* Longest possible binary record: op byte, 10-byte address delta and a 5-byte size */
+#define TRACE_MAX_RECORD 16
+
+/* Formats trace_open can recognize */
+enum TraceFormat {TRACE_TEXT, TRACE_BINARY};
+
+/**
+ * Struct holding one decoded trace record
+ * @param address full 64-bit address of the access
+ * @param size number of bytes accessed
+ * @param op access type, one of 'L', 'S', 'M' or 'I'
+ */
+typedef struct trace_ref {
+    unsigned long long address;
+    int size;
+    char op;
+} trace_ref;
+
+/**
+ * Struct tracking an open trace
+ * @param fd file descriptor the trace is read from
+ * @param format whether the trace is lackey text or binary records
+ * @param data start of the bytes being decoded, either the mapping, buf or tail
+ * @param pos next undecoded byte
+ * @param end one past the last byte the decoder may start a line or record at
+ * @param map start of the file mapping, NULL when streaming
+ * @param map_len length of the mapping
+ * @param buf streaming buffer, NULL when the file is mapped
+ * @param buf_len number of valid bytes in buf
+ * @param eof whether read() has reported the end of the input
+ * @param remaining binary records left to decode, according to the header
+ * @param prev_address last instruction ([1]) and data ([0]) addresses, used to undo the binary delta encoding
+ * @param tail end of a mapped file that cannot be decoded in place: a text line with no newline, or the last few
+ *     binary records, zero padded so the decoder never reads past the mapping
+ * @param tail_len number of bytes copied into tail
+ */
+typedef struct trace_reader {
+    int fd;
+    enum TraceFormat format;
+    const char *data;
+    const char *pos;
+    const char *end;
+    void *map;
+    size_t map_len;
+    char *buf;
+    size_t buf_len;
+    int eof;
+    unsigned long long remaining;
+    unsigned long long prev_address[2];
+    char tail[128];
+    size_t tail_len;
+} trace_reader;
+
+/**
+ * Struct tracking a binary trace being written
+ * @param file output stream
+ * @param count number of records written so far
+ * @param prev_address last instruction ([1]) and data ([0]) addresses written
+ */
+typedef struct trace_writer {
+    FILE *file;
+    unsigned long long count;
+    unsigned long long prev_address[2];
+} trace_writer;
+
+trace_reader *trace_open(const char *path);
+int trace_read_batch(trace_reader *reader, trace_ref *refs, int max_refs);
+void trace_close(trace_reader *reader);
+int trace_split_batch(const trace_ref *refs, int count, int bbits, trace_ref **out, int *out_size);
+
+trace_writer *trace_writer_open(const char *path);
+void trace_write_batch(trace_writer *writer, const trace_ref *refs, int count);
+void trace_writer_close(trace_writer *writer);
+
+#endif /* TRACE_H */
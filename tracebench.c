@@ -0,0 +1,139 @@
+/*
+ * tracebench.c - Measures trace decoding throughput.
+ *
+ * Reads the same trace repeatedly with the original fscanf loop that csim
+ * used and with the trace.c batch reader, and reports MB/s and references/s
+ * for each. Binary traces are only timed with the batch reader.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+/**
+ * Struct holding the outcome of one decoding run
+ * @param refs number of references decoded
+ * @param checksum sum of the decoded sizes, so the decode cannot be optimized away
+ */
+typedef struct bench_result {
+    unsigned long long refs;
+    unsigned long long checksum;
+} bench_result;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Decodes the trace the way csim did before trace.c existed.
+ * @param path trace to read
+ * @return number of references and their checksum
+ */
+bench_result bench_fscanf(const char *path) {
+    bench_result result = {0, 0};
+    char type;
+    unsigned int address;
+    int size;
+
+    FILE *trace_file = fopen(path, "r");
+    while(fscanf(trace_file, " %c %x,%d\n", &type, &address, &size) != -1) {
+        result.refs++;
+        result.checksum += size;
+    }
+    fclose(trace_file);
+    return result;
+}
+
+/**
+ * Decodes the trace with trace_read_batch.
+ * @param path trace to read
+ * @return number of references and their checksum
+ */
+bench_result bench_reader(const char *path) {
+    bench_result result = {0, 0};
+    trace_ref refs[TRACE_BATCH];
+    int count;
+
+    trace_reader *trace = trace_open(path);
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        for(int i = 0; i < count; i++) {
+            result.checksum += refs[i].size;
+        }
+        result.refs += count;
+    }
+    trace_close(trace);
+    return result;
+}
+
+/**
+ * Runs one decoder reps times and prints its best throughput.
+ * @param name label for the output line
+ * @param decode decoder to time
+ * @param path trace to read
+ * @param bytes size of the trace file
+ * @param reps number of runs
+ */
+void report(const char *name, bench_result (*decode)(const char *), const char *path, double bytes, int reps) {
+    double best = -1;
+    bench_result result = {0, 0};
+
+    for(int i = 0; i < reps; i++) {
+        double start = now();
+        result = decode(path);
+        double elapsed = now() - start;
+        if(best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("%-8s %10llu refs %8.3f ms %9.1f MB/s %8.2f Mrefs/s (checksum %llu)\n", name, result.refs,
+           best * 1e3, bytes / best / 1e6, result.refs / best / 1e6, result.checksum);
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 5;
+    char *trace_path = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "r:t:")) != -1) {
+        switch(opt) {
+            case 'r':
+                reps = atoi(optarg);
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            default:
+                break;
+        }
+    }
+
+    struct stat st;
+    if(trace_path == NULL || reps < 1 || stat(trace_path, &st) != 0) {
+        printf("Usage: ./tracebench [-r <reps>] -t <tracefile>\n");
+        exit(0);
+    }
+
+    //fscanf can only read text, so binary traces are timed with the batch reader alone
+    trace_reader *trace = trace_open(trace_path);
+    bool binary = trace != NULL && trace->format == TRACE_BINARY;
+    if(trace != NULL) {
+        trace_close(trace);
+    }
+
+    printf("%s: %.1f MB %s trace, best of %d runs\n", trace_path, st.st_size / 1e6, binary ? "binary" : "text",
+           reps);
+    if(!binary) {
+        report("fscanf", bench_fscanf, trace_path, st.st_size, reps);
+    }
+    report("reader", bench_reader, trace_path, st.st_size, reps);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * traceconv.c - Converts traces between lackey text and the binary format
+ * described in trace.h.
+ *
+ * The input format is detected automatically, so the same tool packs
+ * the traces/ directory or trace.fN into binary form and unpacks binary traces
+ * back into text with -x.
+ *
+ * An event log written by csim -e is recognized too, and written out as
+ * the text csim -v prints (see events.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <string.h>
+#include "trace.h"
+#include "events.h"
+
+//Events decoded at a time from an event log
+#define EVENT_BATCH 4096
+
+void print_usage() {
+    printf("Usage: ./traceconv [-hx] -i <input | -> -o <output | ->\n");
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -x          Write lackey text instead of a binary trace.\n");
+    printf("  -i <file>   Trace to convert, text or binary, or a csim -e event log,\n");
+    printf("              which is always written out as csim -v text.\n");
+    printf("  -o <file>   File to write.\n");
+    printf("Example: ./traceconv -i traces/long.trace -o long.bin\n");
+}
+
+/**
+ * Writes out an event log as the text csim -v prints.
+ * @param in event log, positioned past its header
+ * @param out_path file to write, or - for stdout
+ */
+void decode_events(FILE *in, const char *out_path) {
+    FILE *out = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, "w");
+    if(out == NULL) {
+        printf("Unable to create \"%s\".\n", out_path);
+        exit(1);
+    }
+
+    event_record *events = (event_record *) malloc(sizeof(event_record) * EVENT_BATCH);
+    event_log *log = event_log_open(out, false);
+    int count;
+    while((count = event_read(in, events, EVENT_BATCH)) > 0) {
+        for(int i = 0; i < count; i++) {
+            event_log_add(log, events[i].op, events[i].address, (int) events[i].size, events[i].outcome[0],
+                          events[i].outcome[1]);
+        }
+    }
+    event_log_free(&log);
+    free(events);
+
+    if(out != stdout) {
+        fclose(out);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool text_output = false;
+    char *in_path = NULL;
+    char *out_path = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "hxi:o:")) != -1) {
+        switch(opt) {
+            case 'x':
+                text_output = true;
+                break;
+            case 'i':
+                in_path = optarg;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'h':
+            default:
+                print_usage();
+                exit(0);
+        }
+    }
+
+    if(in_path == NULL || out_path == NULL) {
+        print_usage();
+        exit(0);
+    }
+
+    //An event log is only ever turned back into text
+    if(strcmp(in_path, "-") != 0) {
+        FILE *in = fopen(in_path, "rb");
+        if(in != NULL && event_read_header(in)) {
+            decode_events(in, out_path);
+            fclose(in);
+            return 0;
+        }
+        if(in != NULL) {
+            fclose(in);
+        }
+    }
+
+    trace_reader *trace = trace_open(in_path);
+    if(trace == NULL) {
+        printf("Invalid trace file path \"%s\".\n", in_path);
+        exit(1);
+    }
+
+    //Set up exactly one of the two outputs
+    trace_writer *writer = NULL;
+    FILE *text_file = NULL;
+    if(text_output) {
+        text_file = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, "w");
+    } else {
+        writer = trace_writer_open(out_path);
+    }
+    if(writer == NULL && text_file == NULL) {
+        printf("Unable to create \"%s\".\n", out_path);
+        exit(1);
+    }
+
+    trace_ref *refs = (trace_ref *) malloc(sizeof(trace_ref) * TRACE_BATCH);
+    unsigned long long total = 0;
+    int count;
+
+    while((count = trace_read_batch(trace, refs, TRACE_BATCH)) > 0) {
+        if(writer != NULL) {
+            trace_write_batch(writer, refs, count);
+        } else {
+            //Same layout valgrind uses: instruction fetches start in column 0, data accesses are indented
+            for(int i = 0; i < count; i++) {
+                if(refs[i].op == 'I') {
+                    fprintf(text_file, "I  %08llx,%d\n", refs[i].address, refs[i].size);
+                } else {
+                    fprintf(text_file, " %c %08llx,%d\n", refs[i].op, refs[i].address, refs[i].size);
+                }
+            }
+        }
+        total += count;
+    }
+
+    //Report the size change when both ends are files we can measure
+    long in_bytes = trace->map_len;
+    trace_close(trace);
+
+    FILE *out_file = writer != NULL ? writer->file : text_file;
+    fflush(out_file);
+    long out_bytes = out_file != stdout ? ftell(out_file) : -1;
+
+    if(writer != NULL) {
+        trace_writer_close(writer);
+    } else if(text_file != stdout) {
+        fclose(text_file);
+    }
+
+    if(out_file != stdout) {
+        if(in_bytes > 0 && out_bytes > 0) {
+            printf("%s: %llu refs, %ld -> %ld bytes (%.2fx)\n", in_path, total, in_bytes, out_bytes,
+                   (double) in_bytes / out_bytes);
+        } else {
+            printf("%s: %llu refs\n", in_path, total);
+        }
+    }
+
+    free(refs);
+    return 0;
+}
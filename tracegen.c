@@ -5,6 +5,18 @@
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * Built with -DTRACEGEN_NO_MAIN and -fsanitize=thread, the same code is
+ * linked into test-trans, which records the trace between the markers in
+ * process (see tracerec.h) instead of running valgrind.
+ *
+ * Generic kernels (registerKernelFunction) run on operands of their own,
+ * sized from M, N and K, and are checked against their reference.
+ *
+ * The address ranges of the matrices and of the stack the traced function
+ * runs on are written to .regions (see regions.h), and test-trans gets
+ * them from tracegen_regions, so that misses can be told apart by the
+ * data structure they fall on.
  */
 
 #include <stdlib.h>
@@ -13,22 +25,35 @@
 #include <unistd.h>
 #include <getopt.h>
 #include "cachelab.h"
+#include "regions.h"
 #include <string.h>
 
 /* External variables declared in cachelab.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter; 
 
-/* External function from trans.c */
+/* External functions from trans.c and kernels.c */
 extern void registerFunctions();
+extern void registerKernels();
 
 /* Markers used to bound trace regions of interest */
 volatile char MARKER_START, MARKER_END;
 
+/* Bytes below tracegen_run's frame counted as the traced function's
+   stack, which holds its frame and those of anything it calls */
+#define STACK_REGION (64 * 1024)
+static char *stack_top;
+
 static int A[256][256];
 static int B[256][256];
 static int M;
 static int N;
+static int K;
+
+/* Operands of the generic kernels, each large enough for a 256x256
+   matrix of 8-byte elements, and the pointers the kernels are given */
+static long long operands[MAX_OPERANDS][256 * 256] __attribute__((aligned(64)));
+static void *operand_ptrs[MAX_OPERANDS];
 
 
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
@@ -46,12 +71,163 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/*
+ * tracegen_init - Sets the matrix size and fills A with data. depth is
+ *     the K of the generic kernels.
+ */
+void tracegen_init(int rows, int cols, int depth) {
+    M = rows;
+    N = cols;
+    K = depth;
+    initMatrix(M,N, A, B);
+}
+
+/*
+ * kernel_dim - Returns the size of dimension 'M', 'N' or 'K'
+ */
+static int kernel_dim(char dim) {
+    return dim == 'M' ? M : dim == 'N' ? N : K;
+}
+
+/*
+ * fill_operand - Fills count elements of the given type with random
+ *     whole numbers below limit
+ */
+static void fill_operand(void *op, int count, enum kernel_elem elem, int limit) {
+    for (int i = 0; i < count; i++) {
+        int value = rand() % limit;
+        if (elem == ELEM_LONG)
+            ((long long *) op)[i] = value;
+        else if (elem == ELEM_DOUBLE)
+            ((double *) op)[i] = value;
+        else
+            ((int *) op)[i] = value;
+    }
+}
+
+/*
+ * validate_kernel - Runs generic kernel fn's reference on the same inputs
+ *     and compares its output with the kernel's. Returns 1 if they match.
+ */
+static int validate_kernel(int fn) {
+    trans_func_t *f = &func_list[fn];
+    int out = f->num_operands - 1;
+    int cols = kernel_dim(f->operand_cols[out]);
+    int count = kernel_dim(f->operand_rows[out]) * cols;
+    int size = kernelElemSize(f->elem);
+    void *expected_ptrs[MAX_OPERANDS];
+    char *expected = malloc((size_t) size * count);
+    char *actual = operand_ptrs[out];
+    int i, correct = 1;
+
+    assert(expected);
+    memcpy(expected_ptrs, operand_ptrs, sizeof(operand_ptrs));
+    expected_ptrs[out] = expected;
+    (*f->reference_ptr)(M, N, K, expected_ptrs);
+    for (i = 0; i < count; i++) {
+        if (memcmp(expected + (size_t) i * size, actual + (size_t) i * size, size) != 0) {
+            printf("Validation failed on function %d! Output differs from the reference at [%d][%d]\n",
+                   fn, i / cols, i % cols);
+            correct = 0;
+            break;
+        }
+    }
+    free(expected);
+    return correct;
+}
+
+/*
+ * run_kernel - Invokes generic kernel fn between the two markers, then
+ *     checks its result. The inputs are small whole numbers, so that
+ *     sums of their products are exact in any order and a floating
+ *     point output can be compared exactly; the output starts out as
+ *     garbage.
+ */
+static int run_kernel(int fn) {
+    trans_func_t *f = &func_list[fn];
+    int i, out = f->num_operands - 1;
+
+    for (i = 0; i < f->num_operands; i++) {
+        operand_ptrs[i] = operands[i];
+        fill_operand(operands[i], kernel_dim(f->operand_rows[i]) * kernel_dim(f->operand_cols[i]),
+                     f->elem, i == out ? RAND_MAX : 16);
+    }
+    MARKER_START = 33;
+    (*f->kernel_ptr)(M, N, K, operand_ptrs);
+    MARKER_END = 34;
+    return validate_kernel(fn);
+}
+
+/*
+ * add_region - Appends the size bytes at start to the regions as name
+ */
+static void add_region(region *regions, int *count, const char *name, const void *start, size_t size) {
+    region *r = &regions[(*count)++];
+    strcpy(r->name, name);
+    r->start = (unsigned long long) start;
+    r->end = r->start + size;
+}
+
+/*
+ * tracegen_regions - Fills in the regions function fn touches and returns
+ *     how many there are: A and B (only B, which holds the copy of A, for
+ *     an in-place function), or a generic kernel's operands named A, B,
+ *     C and so on, then the stack. fn -1 gives the regions of a transpose.
+ */
+int tracegen_regions(int fn, region *regions) {
+    trans_func_t *f = &func_list[fn >= 0 ? fn : 0];
+    int i, count = 0;
+
+    if (fn >= 0 && f->kernel_ptr) {
+        for (i = 0; i < f->num_operands; i++) {
+            char name[2] = {'A' + i, '\0'};
+            add_region(regions, &count, name, operands[i], (size_t) kernelElemSize(f->elem) *
+                       kernel_dim(f->operand_rows[i]) * kernel_dim(f->operand_cols[i]));
+        }
+    } else {
+        if (fn < 0 || !f->inplace_ptr)
+            add_region(regions, &count, "A", A, sizeof(int) * M * N);
+        add_region(regions, &count, "B", B, sizeof(int) * M * N);
+    }
+    add_region(regions, &count, "stack", stack_top - STACK_REGION, STACK_REGION);
+    return count;
+}
+
+/*
+ * tracegen_run - Invokes one registered transpose function between the
+ *     two markers, then checks its result. Returns 1 if it is correct.
+ *     B is refilled first, so that a function can't pass on what an
+ *     earlier one left there. An in-place function is given a copy of
+ *     A in B's storage, so that its result is checked like any other's
+ *     and its trace touches only the one matrix.
+ */
+int tracegen_run(int fn) {
+    stack_top = __builtin_frame_address(0);
+    if (func_list[fn].kernel_ptr)
+        return run_kernel(fn);
+
+    randMatrix(N, M, B);
+    if (func_list[fn].inplace_ptr) {
+        memcpy(B, A, sizeof(int) * M * N);
+        MARKER_START = 33;
+        (*func_list[fn].inplace_ptr)(M, N, B);
+        MARKER_END = 34;
+    } else {
+        MARKER_START = 33;
+        (*func_list[fn].func_ptr)(M, N, A, B);
+        MARKER_END = 34;
+    }
+    return validate(fn,M,N,A,B);
+}
+
+#ifndef TRACEGEN_NO_MAIN
 int main(int argc, char* argv[]){
     int i;
 
     char c;
     int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    int kernels=0;
+    while( (c=getopt(argc,argv,"M:N:K:F:k")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -59,9 +235,15 @@ int main(int argc, char* argv[]){
         case 'N':
             N = atoi(optarg);
             break;
+        case 'K':
+            K = atoi(optarg);
+            break;
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'k':
+            kernels = 1;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -72,9 +254,11 @@ int main(int argc, char* argv[]){
 
     /*  Register transpose functions */
     registerFunctions();
+    if (kernels)
+        registerKernels();
 
-    /* Fill A with data */
-    initMatrix(M,N, A, B); 
+    /* Fill A with data, K defaults to M */
+    tracegen_init(M, N, K ? K : M);
 
     /* Record marker addresses */
     FILE* marker_fp = fopen(".marker","w");
@@ -84,24 +268,33 @@ int main(int argc, char* argv[]){
             (unsigned long long int) &MARKER_END );
     fclose(marker_fp);
 
+    /* Record the regions of the selected function, whose frames will be
+       below this one */
+    region regions[MAX_REGIONS];
+    int num_regions;
+    stack_top = __builtin_frame_address(0);
+    num_regions = tracegen_regions(selectedFunc, regions);
+    FILE* regions_fp = fopen(".regions","w");
+    assert(regions_fp);
+    for (i = 0; i < num_regions; i++)
+        fprintf(regions_fp, "%s %llx %llx\n", regions[i].name, regions[i].start, regions[i].end);
+    fclose(regions_fp);
+
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
+            if (func_list[i].square_only && M != N)
+                continue;
+            if (!tracegen_run(i))
                 return i+1;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
+        if (!tracegen_run(selectedFunc))
             return selectedFunc+1;
 
     }
     return 0;
 }
+#endif
 
 
@@ -0,0 +1,121 @@
+/*
+ * tracerec.c - In-process memory trace recording for test-trans
+ *
+ * This file must not be compiled with -fsanitize=thread itself.
+ */
+
+#include "tracerec.h"
+#include <stdlib.h>
+
+/* Records in the buffer when a recording starts */
+#define TRACEREC_INITIAL 65536
+
+//Enum of the recorder's states
+enum RecorderState {RECORDER_IDLE, RECORDER_ARMED, RECORDER_RECORDING};
+
+/**
+ * Struct holding the recorder's state. There is a single recorder, since the hooks cannot be given any context.
+ * @param state idle, waiting for the start marker, or recording
+ * @param start_marker address whose access starts the recording
+ * @param end_marker address whose access ends it
+ * @param refs recorded references
+ * @param count number of recorded references
+ * @param capacity size of refs
+ */
+static struct {
+    enum RecorderState state;
+    const volatile void *start_marker;
+    const volatile void *end_marker;
+    trace_ref *refs;
+    int count;
+    int capacity;
+} recorder;
+
+/**
+ * Arms the recorder. Recording starts at the next access to start_marker.
+ * @param start_marker address whose access starts the recording
+ * @param end_marker address whose access ends it
+ */
+void tracerec_begin(const volatile void *start_marker, const volatile void *end_marker) {
+    recorder.start_marker = start_marker;
+    recorder.end_marker = end_marker;
+    recorder.count = 0;
+    if(recorder.refs == NULL) {
+        recorder.capacity = TRACEREC_INITIAL;
+        recorder.refs = (trace_ref *) malloc(sizeof(trace_ref) * recorder.capacity);
+    }
+    recorder.state = RECORDER_ARMED;
+}
+
+/**
+ * Stops recording.
+ * @param count filled in with the number of recorded references
+ * @return the recorded references, valid until the next tracerec_begin
+ */
+trace_ref *tracerec_end(int *count) {
+    recorder.state = RECORDER_IDLE;
+    *count = recorder.count;
+    return recorder.refs;
+}
+
+/**
+ * Records one access if a recording is in progress, starting or stopping at the markers.
+ * @param addr address accessed
+ * @param size number of bytes accessed
+ * @param op 'L' or 'S'
+ */
+static inline void record(const void *addr, int size, char op) {
+    if(recorder.state == RECORDER_IDLE) {
+        return;
+    }
+    if(recorder.state == RECORDER_ARMED) {
+        if(addr != (const void *) recorder.start_marker) {
+            return;
+        }
+        recorder.state = RECORDER_RECORDING;
+    }
+
+    if(recorder.count == recorder.capacity) {
+        recorder.capacity *= 2;
+        recorder.refs = (trace_ref *) realloc(recorder.refs, sizeof(trace_ref) * recorder.capacity);
+    }
+    trace_ref *ref = &recorder.refs[recorder.count++];
+    ref->address = (unsigned long long) addr;
+    ref->size = size;
+    ref->op = op;
+
+    if(addr == (const void *) recorder.end_marker) {
+        recorder.state = RECORDER_IDLE;
+    }
+}
+
+/*
+ * The hooks -fsanitize=thread code calls. Only plain loads and stores are recorded; the rest exist so that
+ * instrumented objects link without the ThreadSanitizer runtime.
+ */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) {}
+void __tsan_func_exit(void) {}
+
+void __tsan_read1(void *addr) { record(addr, 1, 'L'); }
+void __tsan_read2(void *addr) { record(addr, 2, 'L'); }
+void __tsan_read4(void *addr) { record(addr, 4, 'L'); }
+void __tsan_read8(void *addr) { record(addr, 8, 'L'); }
+void __tsan_read16(void *addr) { record(addr, 16, 'L'); }
+void __tsan_write1(void *addr) { record(addr, 1, 'S'); }
+void __tsan_write2(void *addr) { record(addr, 2, 'S'); }
+void __tsan_write4(void *addr) { record(addr, 4, 'S'); }
+void __tsan_write8(void *addr) { record(addr, 8, 'S'); }
+void __tsan_write16(void *addr) { record(addr, 16, 'S'); }
+
+void __tsan_unaligned_read2(void *addr) { record(addr, 2, 'L'); }
+void __tsan_unaligned_read4(void *addr) { record(addr, 4, 'L'); }
+void __tsan_unaligned_read8(void *addr) { record(addr, 8, 'L'); }
+void __tsan_unaligned_read16(void *addr) { record(addr, 16, 'L'); }
+void __tsan_unaligned_write2(void *addr) { record(addr, 2, 'S'); }
+void __tsan_unaligned_write4(void *addr) { record(addr, 4, 'S'); }
+void __tsan_unaligned_write8(void *addr) { record(addr, 8, 'S'); }
+void __tsan_unaligned_write16(void *addr) { record(addr, 16, 'S'); }
+
+void __tsan_read_range(void *addr, unsigned long size) { record(addr, (int) size, 'L'); }
+void __tsan_write_range(void *addr, unsigned long size) { record(addr, (int) size, 'S'); }
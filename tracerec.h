@@ -0,0 +1,26 @@
+/*
+ * tracerec.h - In-process memory trace recording for test-trans
+ *
+ * Code compiled with -fsanitize=thread calls __tsan_readN(addr) or
+ * __tsan_writeN(addr) before every load and store it makes to memory
+ * (locals kept in registers are not memory). tracerec.c defines those
+ * hooks itself, instead of linking the ThreadSanitizer runtime, and turns
+ * them into trace_ref records in an in-memory buffer.
+ *
+ * Recording is bounded the same way test-trans filters a lackey trace:
+ * it starts with the access to the start marker and stops after the
+ * access to the end marker, both of which are recorded. The result
+ * matches the filtered lackey trace reference for reference, except that
+ * address-taken locals of the transpose function are kept instead of
+ * being dropped with every other stack access.
+ */
+
+#ifndef TRACEREC_H
+#define TRACEREC_H
+
+#include "trace.h"
+
+void tracerec_begin(const volatile void *start_marker, const volatile void *end_marker);
+trace_ref *tracerec_end(int *count);
+
+#endif /* TRACEREC_H */
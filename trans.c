@@ -15,9 +15,39 @@
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
 #include <stdio.h>
+#include <stdlib.h>
 #include "cachelab.h"
+#include "trans_table.h"
 
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int block_width, int block_height, int order,
+                       int diag);
+void transpose_untuned(int M, int N, int A[N][M], int B[M][N]);
+void transpose_buffered(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_edges(int M, int N, int A[N][M], int B[M][N], int full_rows, int full_cols);
+void transpose_recursive(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_recurse(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols);
+
+//Largest block, in rows and columns of A, that transpose_recursive transposes directly
+#define RECURSE_BASE 4
+void transpose_split(int M, int N, int A[N][M], int B[M][N]);
+void transpose_inplace_swap(int M, int N, int A[N][M]);
+void transpose_inplace_cycles(int M, int N, int A[N][M]);
+void transpose_inplace_blocked(int M, int N, int A[N][M]);
+static void transpose_chunks(int rows, int cols, int *a, int chunk);
+long transpose_inplace_scratch(int M, int N);
+
+//Side of the blocks transpose_inplace_swap swaps, and the rows of A transpose_inplace_blocked takes at a time: one line
+// of the lab's cache
+#define INPLACE_BLOCK 8
+
+//Widest matrix whose leftover rows transpose_inplace_blocked can set aside. Wider ones whose rows INPLACE_BLOCK does not
+// divide are followed one int at a time instead.
+#define INPLACE_MAX_COLS 4096
+
+//Where transpose_inplace_blocked sets aside the rows below its last panel. It is static, so that the kernel allocates
+// nothing while it is traced, and outside A, so that test-trans counts it in the memory the kernel touches.
+static int inplace_leftover[(INPLACE_BLOCK - 1) * INPLACE_MAX_COLS];
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -29,35 +59,32 @@ int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N])
 {
-    if(M == 32 && N == 32) {
-        //If the array is 32x32, iterate through 8 by 8 blocks in row major order
-        for(int block_row = 0; block_row < 4; block_row++) {
-            for(int block_col = 0; block_col < 4; block_col++) {
-                //Iterate through each of the blocks in row major order
-                for (int row = 0; row < 8; row++) {
-                    for (int col = 0; col < 8; col++) {
-                        //Transpose data from array A to array B
-                        int copy_a = A[8 * block_row + row][8 * block_col + col];
-                        B[8 * block_col + col][8 * block_row + row] = copy_a;
-                    }
-                }
-            }
-        }
-    } else if(M == 64 && N == 64) {
-        //If the array is 64x64, iterate through 4 by 4 blocks in row major order
-        //If we were to loop over 8x8 blocks like we did for the 32x32 matrix, we would run into issues with collisions
-        // due to the set id's wrapping within each of the 8x8 blocks.
-        for(int block_row = 0; block_row < 16; block_row++) {
-            for (int block_col = 0; block_col < 16; block_col++) {
-                //Iterate through each of the blocks in row major order
-                for (int row = 0; row < 4; row++) {
-                    for (int col = 0; col < 4; col++) {
-                        //Transpose data from array A to array B
-                        int copy_a = A[4 * block_row + row][4 * block_col + col];
-                        B[4 * block_col + col][4 * block_row + row] = copy_a;
-                    }
-                }
-            }
+    //If the autotuner has tuned this shape, use the blocking it found best (see trans_table.h). The table expands to
+    // a chain of comparisons against constants, so dispatching reads nothing from memory.
+#define TRANS_ENTRY(m, n, block_width, block_height, order, diag) \
+    if(M == (m) && N == (n)) { \
+        transpose_blocked(M, N, A, B, block_width, block_height, order, diag); \
+        return; \
+    }
+    TRANS_TABLE
+#undef TRANS_ENTRY
+
+    transpose_untuned(M, N, A, B);
+}
+
+/*
+ * transpose_untuned - What transpose_submit does for shapes trans_table.h has no entry for. autotune only writes an
+ *     entry that beats it.
+ */
+void transpose_untuned(int M, int N, int A[N][M], int B[M][N])
+{
+    //Square power-of-two matrices put the diagonal blocks of A and B in the same sets, so they get kernels that move
+    // whole lines through locals. Up to 32x32, 8 rows of A fit in the cache; beyond that only 4 do.
+    if(M == N && M >= 8 && (M & (M - 1)) == 0) {
+        if(M <= 32) {
+            transpose_buffered(M, N, A, B);
+        } else {
+            transpose_split(M, N, A, B);
         }
     } else {
         //For an arbitrary length array, we split the array up into blocks again with width 8
@@ -111,6 +138,352 @@ void transpose_submit(int M, int N, int A[N][M], int B[M][N])
     }
 }
 
+/*
+ * transpose_blocked - The transpose the autotuner searches over. A is split into blocks of block_width columns by
+ *     block_height rows (smaller at the right and bottom edges), visited row by row when order is 0 or column by
+ *     column when order is 1. With diag set, the element of each row that lies on the diagonal is held in a local
+ *     and written to B after the rest of the row, since on a square matrix A[i][i] and B[i][i] map to the same set.
+ */
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int block_width, int block_height, int order,
+                       int diag)
+{
+    int outer_end = order ? M : N;
+    int outer_step = order ? block_width : block_height;
+    int inner_end = order ? N : M;
+    int inner_step = order ? block_height : block_width;
+
+    for(int outer = 0; outer < outer_end; outer += outer_step) {
+        for(int inner = 0; inner < inner_end; inner += inner_step) {
+            //Find the block's first row and column of A, and where it ends
+            int row_start = order ? inner : outer;
+            int col_start = order ? outer : inner;
+            int row_end = row_start + block_height < N ? row_start + block_height : N;
+            int col_end = col_start + block_width < M ? col_start + block_width : M;
+
+            for(int row = row_start; row < row_end; row++) {
+                int diag_col = -1;
+                int diag_value = 0;
+                for(int col = col_start; col < col_end; col++) {
+                    if(diag && row == col) {
+                        diag_col = col;
+                        diag_value = A[row][col];
+                    } else {
+                        B[col][row] = A[row][col];
+                    }
+                }
+                if(diag_col != -1) {
+                    B[diag_col][row] = diag_value;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * transpose_buffered - Transposes 8x8 blocks, loading each 8-int row of A into locals before storing any of it to B.
+ *     A's line is read in full before B's writes can evict it, so diagonal blocks, where a row of A and the column
+ *     of B it goes to share sets, only miss once more per row. Rows and columns past the last full block are
+ *     transposed plainly.
+ */
+char transpose_buffered_desc[] = "8x8 blocks through 8 locals";
+void transpose_buffered(int M, int N, int A[N][M], int B[M][N])
+{
+    int a0, a1, a2, a3, a4, a5, a6, a7;
+
+    for(int block_row = 0; block_row + 8 <= N; block_row += 8) {
+        for(int block_col = 0; block_col + 8 <= M; block_col += 8) {
+            for(int row = block_row; row < block_row + 8; row++) {
+                //Read the whole line of A first
+                a0 = A[row][block_col];
+                a1 = A[row][block_col + 1];
+                a2 = A[row][block_col + 2];
+                a3 = A[row][block_col + 3];
+                a4 = A[row][block_col + 4];
+                a5 = A[row][block_col + 5];
+                a6 = A[row][block_col + 6];
+                a7 = A[row][block_col + 7];
+
+                B[block_col][row] = a0;
+                B[block_col + 1][row] = a1;
+                B[block_col + 2][row] = a2;
+                B[block_col + 3][row] = a3;
+                B[block_col + 4][row] = a4;
+                B[block_col + 5][row] = a5;
+                B[block_col + 6][row] = a6;
+                B[block_col + 7][row] = a7;
+            }
+        }
+    }
+    transpose_edges(M, N, A, B, N - N % 8, M - M % 8);
+}
+
+/*
+ * transpose_split - Transposes 8x8 blocks as four 4x4 quarters when only 4 rows of B fit in the cache at once (64x64
+ *     on the 1KB cache), while still using all 8 ints of every line it loads:
+ *       1. Each of A's top 4 rows goes to B's top 4 rows: the left half where it belongs, the right half parked in
+ *          B's top-right quarter.
+ *       2. For each of B's top 4 rows, the parked half is read back into locals, replaced with A's bottom-left
+ *          quarter (read a column at a time), and then written to its own row among B's bottom 4.
+ *       3. A's bottom-right quarter goes to B's bottom-right quarter.
+ *     Rows and columns past the last full block are transposed plainly.
+ */
+char transpose_split_desc[] = "8x8 blocks split into 4x4 quarters";
+void transpose_split(int M, int N, int A[N][M], int B[M][N])
+{
+    int a0, a1, a2, a3, a4, a5, a6, a7;
+
+    for(int block_row = 0; block_row + 8 <= N; block_row += 8) {
+        for(int block_col = 0; block_col + 8 <= M; block_col += 8) {
+            //Step 1: A's top half, left quarter to its place and right quarter parked
+            for(int row = block_row; row < block_row + 4; row++) {
+                a0 = A[row][block_col];
+                a1 = A[row][block_col + 1];
+                a2 = A[row][block_col + 2];
+                a3 = A[row][block_col + 3];
+                a4 = A[row][block_col + 4];
+                a5 = A[row][block_col + 5];
+                a6 = A[row][block_col + 6];
+                a7 = A[row][block_col + 7];
+
+                B[block_col][row] = a0;
+                B[block_col + 1][row] = a1;
+                B[block_col + 2][row] = a2;
+                B[block_col + 3][row] = a3;
+                B[block_col][row + 4] = a4;
+                B[block_col + 1][row + 4] = a5;
+                B[block_col + 2][row + 4] = a6;
+                B[block_col + 3][row + 4] = a7;
+            }
+
+            //Step 2: swap the parked quarter for A's bottom-left quarter, one row of B at a time
+            for(int col = block_col; col < block_col + 4; col++) {
+                a0 = A[block_row + 4][col];
+                a1 = A[block_row + 5][col];
+                a2 = A[block_row + 6][col];
+                a3 = A[block_row + 7][col];
+
+                a4 = B[col][block_row + 4];
+                a5 = B[col][block_row + 5];
+                a6 = B[col][block_row + 6];
+                a7 = B[col][block_row + 7];
+
+                B[col][block_row + 4] = a0;
+                B[col][block_row + 5] = a1;
+                B[col][block_row + 6] = a2;
+                B[col][block_row + 7] = a3;
+
+                B[col + 4][block_row] = a4;
+                B[col + 4][block_row + 1] = a5;
+                B[col + 4][block_row + 2] = a6;
+                B[col + 4][block_row + 3] = a7;
+            }
+
+            //Step 3: A's bottom-right quarter
+            for(int row = block_row + 4; row < block_row + 8; row++) {
+                a0 = A[row][block_col + 4];
+                a1 = A[row][block_col + 5];
+                a2 = A[row][block_col + 6];
+                a3 = A[row][block_col + 7];
+
+                B[block_col + 4][row] = a0;
+                B[block_col + 5][row] = a1;
+                B[block_col + 6][row] = a2;
+                B[block_col + 7][row] = a3;
+            }
+        }
+    }
+    transpose_edges(M, N, A, B, N - N % 8, M - M % 8);
+}
+
+/*
+ * transpose_edges - Transposes the columns of A from full_cols on, then the rows from full_rows on, which a blocked
+ *     kernel leaves when its blocks do not divide the matrix
+ */
+static void transpose_edges(int M, int N, int A[N][M], int B[M][N], int full_rows, int full_cols)
+{
+    for(int row = 0; row < N; row++) {
+        for(int col = full_cols; col < M; col++) {
+            B[col][row] = A[row][col];
+        }
+    }
+    for(int row = full_rows; row < N; row++) {
+        for(int col = 0; col < full_cols; col++) {
+            B[col][row] = A[row][col];
+        }
+    }
+}
+
+/*
+ * transpose_recursive - Cache-oblivious transpose. The larger dimension of A is halved until a block is at most
+ *     RECURSE_BASE by RECURSE_BASE, which is then transposed directly. Whatever the cache's size and line length, some
+ *     level of the recursion has blocks whose lines of A and B fit in the cache together, so no geometry needs its
+ *     own tuning.
+ */
+char transpose_recursive_desc[] = "Cache-oblivious recursive transpose";
+void transpose_recursive(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_recurse(M, N, A, B, 0, 0, N, M);
+}
+
+/*
+ * transpose_recurse - Transposes the rows by cols block of A starting at (row, col)
+ */
+static void transpose_recurse(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols)
+{
+    if(rows <= RECURSE_BASE && cols <= RECURSE_BASE) {
+        for(int i = row; i < row + rows; i++) {
+            for(int j = col; j < col + cols; j++) {
+                B[j][i] = A[i][j];
+            }
+        }
+    } else if(rows >= cols) {
+        transpose_recurse(M, N, A, B, row, col, rows / 2, cols);
+        transpose_recurse(M, N, A, B, row + rows / 2, col, rows - rows / 2, cols);
+    } else {
+        transpose_recurse(M, N, A, B, row, col, rows, cols / 2);
+        transpose_recurse(M, N, A, B, row, col + cols / 2, rows, cols - cols / 2);
+    }
+}
+
+/*
+ * In-place transposes. These take the N x M matrix in A and leave its M x N transpose in the same memory, so they
+ * need half the memory of the other functions. The driver runs them on a copy of A.
+ */
+
+/*
+ * transpose_inplace_swap - Swaps A[row][col] with A[col][row] one pair of INPLACE_BLOCK square blocks at a time, so
+ *     both blocks' lines are reused while they are in the cache. Only square matrices can be transposed by swapping,
+ *     so M must equal N; it is registered with registerSquareInPlaceTransFunction so that it is not run on others.
+ */
+char transpose_inplace_swap_desc[] = "In-place blocked swap transpose";
+void transpose_inplace_swap(int M, int N, int A[N][M])
+{
+    for(int block_row = 0; block_row < N; block_row += INPLACE_BLOCK) {
+        int row_end = block_row + INPLACE_BLOCK < N ? block_row + INPLACE_BLOCK : N;
+        for(int block_col = block_row; block_col < N; block_col += INPLACE_BLOCK) {
+            int col_end = block_col + INPLACE_BLOCK < N ? block_col + INPLACE_BLOCK : N;
+            for(int row = block_row; row < row_end; row++) {
+                //A diagonal block is swapped with itself, so only its upper triangle is walked
+                for(int col = block_col == block_row ? row + 1 : block_col; col < col_end; col++) {
+                    int tmp = A[row][col];
+                    A[row][col] = A[col][row];
+                    A[col][row] = tmp;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * transpose_inplace_cycles - Moves every element straight to its place in A^T by following the cycles of the
+ *     permutation (see transpose_chunks). Each element is read and written once, but consecutive moves land far
+ *     apart, so nearly every one misses.
+ */
+char transpose_inplace_cycles_desc[] = "In-place cycle-following transpose";
+void transpose_inplace_cycles(int M, int N, int A[N][M])
+{
+    transpose_chunks(N, M, &A[0][0], 1);
+}
+
+/*
+ * transpose_inplace_blocked - Cycle-following on runs of ints instead of single ones. The rows of A are taken
+ *     INPLACE_BLOCK (c) at a time; each such panel is contiguous, and is transposed in place into M rows of c ints.
+ *     Row j of panel p then belongs at columns p * c to p * c + c - 1 of row j of A^T, so the runs form a panels by M
+ *     matrix whose transpose is A^T, which is followed in runs of c ints. A run is a whole line, so the long moves
+ *     cost one miss per 8 ints instead of one per int. When c does not divide N, the fewer than c rows below the last
+ *     panel are set aside in inplace_leftover, transposed, before the panels are transposed; each row of the panels'
+ *     result is then moved out to its place in A^T, and the buffer's columns fill in the ends of the rows.
+ */
+char transpose_inplace_blocked_desc[] = "In-place blocked cycle-following transpose";
+void transpose_inplace_blocked(int M, int N, int A[N][M])
+{
+    int chunk = INPLACE_BLOCK;
+    int rest = N % chunk;
+    int full = N - rest;
+    int *a = &A[0][0];
+    int *leftover = inplace_leftover;
+
+    //Too few rows for one panel, or too many columns for the buffer
+    if(full == 0 || (rest > 0 && M > INPLACE_MAX_COLS)) {
+        transpose_chunks(N, M, a, 1);
+        return;
+    }
+
+    if(rest > 0) {
+        for(int row = 0; row < rest; row++) {
+            for(int col = 0; col < M; col++) {
+                leftover[(long) col * rest + row] = A[full + row][col];
+            }
+        }
+    }
+
+    for(int row = 0; row < full; row += chunk) {
+        transpose_chunks(chunk, M, &A[row][0], 1);
+    }
+    transpose_chunks(full / chunk, M, a, chunk);
+
+    if(rest > 0) {
+        //Row j of the panels' transpose is at j * full and belongs at j * N. Moving the rows from the last one back
+        // never overwrites one not moved yet.
+        for(long row = M - 1; row >= 0; row--) {
+            for(int col = rest - 1; col >= 0; col--) {
+                a[row * N + full + col] = leftover[row * rest + col];
+            }
+            for(int col = full - 1; col >= 0; col--) {
+                a[row * N + col] = a[row * full + col];
+            }
+        }
+    }
+}
+
+/*
+ * transpose_inplace_scratch - Returns the bytes of inplace_leftover transpose_inplace_blocked uses besides A when
+ *     transposing an N x M matrix
+ */
+long transpose_inplace_scratch(int M, int N)
+{
+    int rest = N % INPLACE_BLOCK;
+    if(N < INPLACE_BLOCK || rest == 0 || M > INPLACE_MAX_COLS) {
+        return 0;
+    }
+    return (long) sizeof(int) * rest * M;
+}
+
+/*
+ * transpose_chunks - Transposes, in place, the rows by cols matrix at a whose elements are runs of chunk ints. The
+ *     run at index q belongs at index q * rows mod (rows * cols - 1), and the first and last stay put. Each cycle of
+ *     that permutation is moved once, from its smallest index; whether an index is the smallest is found by walking
+ *     its cycle without touching memory, so no record of finished cycles is needed.
+ */
+static void transpose_chunks(int rows, int cols, int *a, int chunk)
+{
+    long last = (long) rows * cols - 1;
+
+    if(rows == 1 || cols == 1) {
+        return;
+    }
+
+    for(long start = 1; start < last; start++) {
+        long next = start * rows % last;
+        while(next > start) {
+            next = next * rows % last;
+        }
+        if(next < start) {
+            continue;
+        }
+
+        //The run at start holds the one in flight: swapping it with each place along the cycle drops it there and
+        // picks up the next. This needs no buffer, and the run at start stays in the cache throughout.
+        for(next = start * rows % last; next != start; next = next * rows % last) {
+            for(int k = 0; k < chunk; k++) {
+                int tmp = a[start * chunk + k];
+                a[start * chunk + k] = a[next * chunk + k];
+                a[next * chunk + k] = tmp;
+            }
+        }
+    }
+}
+
 /* 
  * You can define additional transpose functions below. We've defined
  * a simple one below to help you get started. 
@@ -146,6 +519,12 @@ void registerFunctions()
 
     /* Register any additional transpose functions */
     registerTransFunction(trans, trans_desc); 
+    registerTransFunction(transpose_buffered, transpose_buffered_desc);
+    registerTransFunction(transpose_split, transpose_split_desc);
+    registerTransFunction(transpose_recursive, transpose_recursive_desc);
+    registerSquareInPlaceTransFunction(transpose_inplace_swap, transpose_inplace_swap_desc);
+    registerInPlaceTransFunction(transpose_inplace_cycles, transpose_inplace_cycles_desc);
+    registerInPlaceTransFunction(transpose_inplace_blocked, transpose_inplace_blocked_desc);
 
 }
 
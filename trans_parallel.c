@@ -0,0 +1,275 @@
+/*
+ * trans_parallel.c - Multi-threaded tiled transpose for large matrices
+ */
+#define _GNU_SOURCE
+
+#include "trans_parallel.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+//Fewest tiles worth handing to a worker. Smaller jobs use fewer workers, and a job of fewer than twice this many
+//tiles runs on the calling thread alone, since waking the pool costs more than it saves.
+#define MIN_WORKER_TILES 16
+
+//Vector transpose of one region, defined in trans_simd.c
+extern void transpose_simd_region(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols);
+
+/**
+ * Work the pool's threads can be asked to do.
+ * POOL_TOUCH zeroes each thread's tiles of A and B, POOL_TRANSPOSE transposes them, POOL_EXIT ends the threads.
+ */
+enum pool_op {POOL_TOUCH, POOL_TRANSPOSE, POOL_EXIT};
+
+/**
+ * Struct passed to each worker thread.
+ * @param pool the pool the worker belongs to
+ * @param id the worker's index, which picks its share of the tiles
+ */
+typedef struct pool_worker {
+    transpose_pool *pool;
+    int id;
+} pool_worker;
+
+/**
+ * Struct holding a pool of threads and the job they are working on. The calling thread is worker 0, so only
+ * threads - 1 threads are created.
+ * @param threads number of workers, including the calling thread
+ * @param workers the created threads
+ * @param args argument of each worker
+ * @param start barrier the workers wait on for a job
+ * @param done barrier the workers wait on once their share of the job is finished
+ * @param op what the current job is
+ * @param active number of workers the current job's tiles are split between, the rest sit it out
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A source matrix, N rows of M ints
+ * @param B destination matrix, M rows of N ints
+ */
+struct transpose_pool {
+    int threads;
+    pthread_t *workers;
+    pool_worker *args;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    enum pool_op op;
+    int active;
+    int M;
+    int N;
+    int *A;
+    int *B;
+};
+
+/**
+ * Runs one worker's share of the pool's current job. Tile k is at tile row k % tiles_down and tile column
+ * k / tiles_down of A, and worker id gets the tiles from total * id / threads up to total * (id + 1) / threads.
+ * @param pool pool holding the job
+ * @param id worker index
+ * @param threads number of workers the tiles are split between
+ */
+static void run_tiles(transpose_pool *pool, int id, int threads) {
+    int M = pool->M;
+    int N = pool->N;
+    int (*A)[M] = (int (*)[M]) pool->A;
+    int (*B)[N] = (int (*)[N]) pool->B;
+    long tiles_down = (N + TRANS_TILE - 1) / TRANS_TILE;
+    long total = tiles_down * ((M + TRANS_TILE - 1) / TRANS_TILE);
+    long first = total * id / threads;
+    long last = total * (id + 1) / threads;
+
+    for(long k = first; k < last; k++) {
+        int row = (int) (k % tiles_down) * TRANS_TILE;
+        int col = (int) (k / tiles_down) * TRANS_TILE;
+        int rows = N - row < TRANS_TILE ? N - row : TRANS_TILE;
+        int cols = M - col < TRANS_TILE ? M - col : TRANS_TILE;
+
+        if(pool->op == POOL_TOUCH) {
+            for(int i = row; i < row + rows; i++) {
+                memset(&A[i][col], 0, sizeof(int) * cols);
+            }
+            for(int j = col; j < col + cols; j++) {
+                memset(&B[j][row], 0, sizeof(int) * rows);
+            }
+        } else {
+            transpose_simd_region(M, N, A, B, row, col, rows, cols);
+        }
+    }
+}
+
+/**
+ * Pins the calling thread to the id-th CPU it is allowed to run on, wrapping around if there are fewer CPUs than
+ * workers, so that it stays near the pages it first touched. Failures are ignored, since pinning only helps speed.
+ * @param id worker index
+ */
+static void pin_worker(int id) {
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+
+    int skip = id % CPU_COUNT(&allowed);
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+            return;
+        }
+    }
+}
+
+/**
+ * Worker loop: waits for a job, runs its share, and waits for the others to finish, until told to exit.
+ * @param arg the worker's pool_worker
+ * @return NULL
+ */
+static void *pool_thread(void *arg) {
+    pool_worker *worker = (pool_worker *) arg;
+    transpose_pool *pool = worker->pool;
+
+    pin_worker(worker->id);
+    while(true) {
+        pthread_barrier_wait(&pool->start);
+        if(pool->op == POOL_EXIT) {
+            break;
+        }
+        if(worker->id < pool->active) {
+            run_tiles(pool, worker->id, pool->active);
+        }
+        pthread_barrier_wait(&pool->done);
+    }
+    return NULL;
+}
+
+/**
+ * Hands a job to the pool and runs the calling thread's share, returning once every worker has finished.
+ * @param pool pool to run on
+ * @param op job to run
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A first int of the source matrix
+ * @param B first int of the destination matrix
+ */
+static void run_job(transpose_pool *pool, enum pool_op op, int M, int N, int *A, int *B) {
+    pool->op = op;
+    pool->M = M;
+    pool->N = N;
+    pool->A = A;
+    pool->B = B;
+
+    long tiles = (long) ((M + TRANS_TILE - 1) / TRANS_TILE) * ((N + TRANS_TILE - 1) / TRANS_TILE);
+    pool->active = tiles / MIN_WORKER_TILES < pool->threads ? (int) (tiles / MIN_WORKER_TILES) : pool->threads;
+    if(pool->active <= 1) {
+        pool->active = 1;
+        run_tiles(pool, 0, 1);
+        return;
+    }
+    pthread_barrier_wait(&pool->start);
+    run_tiles(pool, 0, pool->active);
+    pthread_barrier_wait(&pool->done);
+}
+
+/**
+ * Starts a pool of threads for transpose_parallel. The calling thread takes part in every job as worker 0, and
+ * unless it is the only worker it is pinned like the others.
+ * @param threads number of workers, including the calling thread
+ * @return the pool, or NULL if threads is less than 1
+ */
+transpose_pool *transpose_pool_create(int threads) {
+    if(threads < 1) {
+        return NULL;
+    }
+
+    transpose_pool *pool = (transpose_pool *) calloc(1, sizeof(transpose_pool));
+    pool->threads = threads;
+    pool->workers = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    pool->args = (pool_worker *) calloc(threads, sizeof(pool_worker));
+    pthread_barrier_init(&pool->start, NULL, threads);
+    pthread_barrier_init(&pool->done, NULL, threads);
+
+    if(threads > 1) {
+        pin_worker(0);
+    }
+    for(int i = 1; i < threads; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].id = i;
+        pthread_create(&pool->workers[i], NULL, pool_thread, &pool->args[i]);
+    }
+    return pool;
+}
+
+/**
+ * Reads the number of workers in a pool.
+ * @param pool pool to read
+ * @return the number of workers, including the calling thread
+ */
+int transpose_pool_threads(const transpose_pool *pool) {
+    return pool->threads;
+}
+
+/**
+ * Zeroes A and B, each tile by the worker that transpose_parallel will give it to, so that on a NUMA machine the
+ * pages are placed on that worker's node. Call it on freshly allocated matrices before filling in A.
+ * @param pool pool whose workers touch the pages
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A source matrix
+ * @param B destination matrix
+ */
+void transpose_pool_touch(transpose_pool *pool, int M, int N, int A[N][M], int B[M][N]) {
+    run_job(pool, POOL_TOUCH, M, N, &A[0][0], &B[0][0]);
+}
+
+/**
+ * Transposes A into B, with the tiles split between the pool's workers.
+ * @param pool pool to run on
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A source matrix
+ * @param B destination matrix
+ */
+void transpose_parallel(transpose_pool *pool, int M, int N, int A[N][M], int B[M][N]) {
+    run_job(pool, POOL_TRANSPOSE, M, N, &A[0][0], &B[0][0]);
+}
+
+/**
+ * Stops a pool's threads and frees it.
+ * @param pool pool to free, set to NULL
+ */
+void transpose_pool_free(transpose_pool **pool) {
+    transpose_pool *p = *pool;
+    if(p->threads > 1) {
+        p->op = POOL_EXIT;
+        pthread_barrier_wait(&p->start);
+        for(int i = 1; i < p->threads; i++) {
+            pthread_join(p->workers[i], NULL);
+        }
+    }
+    pthread_barrier_destroy(&p->start);
+    pthread_barrier_destroy(&p->done);
+    free(p->workers);
+    free(p->args);
+    free(p);
+    *pool = NULL;
+}
+
+/**
+ * Transposes A into B one tile at a time on the calling thread, in the same order as transpose_parallel, as its
+ * serial baseline.
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A source matrix
+ * @param B destination matrix
+ */
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N]) {
+    for(int col = 0; col < M; col += TRANS_TILE) {
+        for(int row = 0; row < N; row += TRANS_TILE) {
+            int rows = N - row < TRANS_TILE ? N - row : TRANS_TILE;
+            int cols = M - col < TRANS_TILE ? M - col : TRANS_TILE;
+            transpose_simd_region(M, N, A, B, row, col, rows, cols);
+        }
+    }
+}
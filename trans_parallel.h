@@ -0,0 +1,36 @@
+/*
+ * trans_parallel.h - Multi-threaded tiled transpose for large matrices
+ *
+ * The matrix is cut into TRANS_TILE x TRANS_TILE tiles, each transposed
+ * with the widest vector kernel the CPU supports (see trans_simd.c). The
+ * tiles are numbered down each column of tiles of A, which is along each
+ * row of tiles of B, and a pool of threads splits that numbering into
+ * contiguous runs, one per thread. So each thread writes a contiguous part
+ * of B and reads the matching tiles of A.
+ *
+ * On a NUMA machine a page lives on the node of the thread that first
+ * touches it. transpose_pool_touch zeroes A and B with the same threads
+ * and the same split as transpose_parallel, so each thread's tiles are
+ * placed on its own node before the matrices are filled in, and the
+ * threads are pinned to CPUs so they do not move away from them.
+ *
+ * transpose_tiled runs the same tiles in the same order on the calling
+ * thread, as the serial baseline.
+ */
+
+#ifndef TRANS_PARALLEL_H
+#define TRANS_PARALLEL_H
+
+//Tile side, in ints. A tile of A and one of B take 32KB, which fits in the L2 cache of any current CPU.
+#define TRANS_TILE 64
+
+typedef struct transpose_pool transpose_pool;
+
+transpose_pool *transpose_pool_create(int threads);
+int transpose_pool_threads(const transpose_pool *pool);
+void transpose_pool_touch(transpose_pool *pool, int M, int N, int A[N][M], int B[M][N]);
+void transpose_parallel(transpose_pool *pool, int M, int N, int A[N][M], int B[M][N]);
+void transpose_pool_free(transpose_pool **pool);
+void transpose_tiled(int M, int N, int A[N][M], int B[M][N]);
+
+#endif /* TRANS_PARALLEL_H */
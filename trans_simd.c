@@ -0,0 +1,219 @@
+/*
+ * trans_simd.c - Vectorized transposes B = A^T
+ *
+ * These kernels load rows of A into vector registers, transpose a whole
+ * block inside the registers with unpack and permute instructions, and
+ * store each transposed row to B in one instruction. transpose_sse2 moves
+ * 4x4 blocks, transpose_avx2 moves 8x8 blocks, and transpose_simd picks
+ * the widest one the CPU supports when it is called. Rows and columns
+ * past the last full block, and CPUs without SSE2, are handled with a
+ * scalar loop.
+ *
+ * They are for real speed (see transbench.c), so they are not registered
+ * with the driver: the driver only counts misses, which says little about
+ * code that moves 16 or 32 bytes per instruction.
+ */
+#include <stdio.h>
+#include "cachelab.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+int simd_level(void);
+void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+void transpose_simd_region(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols);
+void transpose_sse2(int M, int N, int A[N][M], int B[M][N]);
+void transpose_avx2(int M, int N, int A[N][M], int B[M][N]);
+static void transpose_scalar(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols,
+                             int full_rows, int full_cols);
+
+/*
+ * transpose_scalar - Transposes the row..row+rows by col..col+cols region
+ *     of A, except for its first full_rows by full_cols corner, which the
+ *     vector kernels have already moved
+ */
+static void transpose_scalar(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols,
+                             int full_rows, int full_cols)
+{
+    for(int i = row; i < row + rows; i++) {
+        for(int j = col + full_cols; j < col + cols; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+    for(int i = row + full_rows; i < row + rows; i++) {
+        for(int j = col; j < col + full_cols; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * sse2_region - Transposes 4x4 blocks of ints of a region of A in SSE2
+ *     registers
+ */
+__attribute__((target("sse2")))
+static void sse2_region(int M, int N, int A[N][M], int B[M][N], int row0, int col0, int rows, int cols)
+{
+    for(int row = row0; row + 4 <= row0 + rows; row += 4) {
+        for(int col = col0; col + 4 <= col0 + cols; col += 4) {
+            //Rows a, b, c, d of the block
+            __m128i r0 = _mm_loadu_si128((__m128i *) &A[row][col]);
+            __m128i r1 = _mm_loadu_si128((__m128i *) &A[row + 1][col]);
+            __m128i r2 = _mm_loadu_si128((__m128i *) &A[row + 2][col]);
+            __m128i r3 = _mm_loadu_si128((__m128i *) &A[row + 3][col]);
+
+            //a0 b0 a1 b1, c0 d0 c1 d1, a2 b2 a3 b3, c2 d2 c3 d3
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+            //Column k of the block is now a whole register
+            _mm_storeu_si128((__m128i *) &B[col][row], _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) &B[col + 1][row], _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *) &B[col + 2][row], _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i *) &B[col + 3][row], _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+    transpose_scalar(M, N, A, B, row0, col0, rows, cols, rows - rows % 4, cols - cols % 4);
+}
+
+/*
+ * transpose_sse2 - Transposes 4x4 blocks of ints in SSE2 registers
+ */
+char transpose_sse2_desc[] = "SSE2 4x4 in-register transpose";
+void transpose_sse2(int M, int N, int A[N][M], int B[M][N])
+{
+    sse2_region(M, N, A, B, 0, 0, N, M);
+}
+
+/*
+ * avx2_region - Transposes 8x8 blocks of ints of a region of A in AVX2
+ *     registers. The unpacks work within each 128-bit half, so they
+ *     transpose the two 4x4 halves of each pair of 4 rows, and the final
+ *     permutes swap the halves across rows 0-3 and 4-7.
+ */
+__attribute__((target("avx2")))
+static void avx2_region(int M, int N, int A[N][M], int B[M][N], int row0, int col0, int rows, int cols)
+{
+    for(int row = row0; row + 8 <= row0 + rows; row += 8) {
+        for(int col = col0; col + 8 <= col0 + cols; col += 8) {
+            __m256i r0 = _mm256_loadu_si256((__m256i *) &A[row][col]);
+            __m256i r1 = _mm256_loadu_si256((__m256i *) &A[row + 1][col]);
+            __m256i r2 = _mm256_loadu_si256((__m256i *) &A[row + 2][col]);
+            __m256i r3 = _mm256_loadu_si256((__m256i *) &A[row + 3][col]);
+            __m256i r4 = _mm256_loadu_si256((__m256i *) &A[row + 4][col]);
+            __m256i r5 = _mm256_loadu_si256((__m256i *) &A[row + 5][col]);
+            __m256i r6 = _mm256_loadu_si256((__m256i *) &A[row + 6][col]);
+            __m256i r7 = _mm256_loadu_si256((__m256i *) &A[row + 7][col]);
+
+            //Interleave pairs of rows: a0 b0 a1 b1 | a4 b4 a5 b5, and so on
+            __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+            __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+            __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+            __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+            __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+            __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+            __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+            __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+            //Interleave pairs of pairs: a0 b0 c0 d0 | a4 b4 c4 d4, and so on
+            __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+            __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+            __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+            __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+            __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+            __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+            __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+            __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+            //Join the halves of rows a-d and e-h
+            _mm256_storeu_si256((__m256i *) &B[col][row], _mm256_permute2x128_si256(u0, u4, 0x20));
+            _mm256_storeu_si256((__m256i *) &B[col + 1][row], _mm256_permute2x128_si256(u1, u5, 0x20));
+            _mm256_storeu_si256((__m256i *) &B[col + 2][row], _mm256_permute2x128_si256(u2, u6, 0x20));
+            _mm256_storeu_si256((__m256i *) &B[col + 3][row], _mm256_permute2x128_si256(u3, u7, 0x20));
+            _mm256_storeu_si256((__m256i *) &B[col + 4][row], _mm256_permute2x128_si256(u0, u4, 0x31));
+            _mm256_storeu_si256((__m256i *) &B[col + 5][row], _mm256_permute2x128_si256(u1, u5, 0x31));
+            _mm256_storeu_si256((__m256i *) &B[col + 6][row], _mm256_permute2x128_si256(u2, u6, 0x31));
+            _mm256_storeu_si256((__m256i *) &B[col + 7][row], _mm256_permute2x128_si256(u3, u7, 0x31));
+        }
+    }
+    transpose_scalar(M, N, A, B, row0, col0, rows, cols, rows - rows % 8, cols - cols % 8);
+}
+
+/*
+ * transpose_avx2 - Transposes 8x8 blocks of ints in AVX2 registers
+ */
+char transpose_avx2_desc[] = "AVX2 8x8 in-register transpose";
+void transpose_avx2(int M, int N, int A[N][M], int B[M][N])
+{
+    avx2_region(M, N, A, B, 0, 0, N, M);
+}
+
+#else
+
+/* Without x86 vector instructions, both kernels are the scalar loop */
+char transpose_sse2_desc[] = "SSE2 4x4 in-register transpose (scalar)";
+void transpose_sse2(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_scalar(M, N, A, B, 0, 0, N, M, 0, 0);
+}
+
+char transpose_avx2_desc[] = "AVX2 8x8 in-register transpose (scalar)";
+void transpose_avx2(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_scalar(M, N, A, B, 0, 0, N, M, 0, 0);
+}
+
+#endif
+
+/*
+ * simd_level - Returns 2 if this CPU runs transpose_avx2, 1 if it only
+ *     runs transpose_sse2, and 0 if it runs neither
+ */
+int simd_level(void)
+{
+#ifdef HAVE_X86_SIMD
+    if(__builtin_cpu_supports("avx2")) {
+        return 2;
+    } else if(__builtin_cpu_supports("sse2")) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * transpose_simd - Runs the widest vector kernel this CPU supports
+ */
+char transpose_simd_desc[] = "Widest supported SIMD transpose";
+void transpose_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_simd_region(M, N, A, B, 0, 0, N, M);
+}
+
+/*
+ * transpose_simd_region - Transposes the rows row..row+rows and columns
+ *     col..col+cols of A into B with the widest vector kernel this CPU
+ *     supports. The tiled kernels in trans_parallel.c call this per tile.
+ */
+void transpose_simd_region(int M, int N, int A[N][M], int B[M][N], int row, int col, int rows, int cols)
+{
+    switch(simd_level()) {
+#ifdef HAVE_X86_SIMD
+        case 2:
+            avx2_region(M, N, A, B, row, col, rows, cols);
+            break;
+        case 1:
+            sse2_region(M, N, A, B, row, col, rows, cols);
+            break;
+#endif
+        default:
+            transpose_scalar(M, N, A, B, row, col, rows, cols, 0, 0);
+            break;
+    }
+}
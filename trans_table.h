@@ -0,0 +1,18 @@
+/*
+ * trans_table.h - Blocking for transpose_submit, written by autotune
+ *
+ * Each TRANS_ENTRY(M, N, block_width, block_height, order, diag) gives
+ * the transpose_blocked parameters with the fewest simulated misses for
+ * one matrix shape, and takes precedence over transpose_submit's own
+ * kernels. Shapes without an entry use those; autotune leaves out shapes
+ * it cannot improve on. Tuned for s=5, E=1, b=5.
+ */
+
+#ifndef TRANS_TABLE_H
+#define TRANS_TABLE_H
+
+#define TRANS_TABLE \
+    TRANS_ENTRY(61, 67, 1, 14, 0, 0) /* 1808 misses */ \
+
+
+#endif /* TRANS_TABLE_H */
@@ -0,0 +1,317 @@
+/*
+ * transbench.c - Times transpose functions on the real machine
+ *
+ * test-trans counts simulated misses on the lab's cache. This instead runs
+ * each kernel, built with -O2, on heap matrices of any size (there is no
+ * MAXN limit here) and measures it with clock_gettime and the time stamp
+ * counter. Every kernel is run once per size to check its result and warm
+ * the caches, then timed over a number of runs; the fastest run is
+ * reported. Small matrices are transposed several times per run so that a
+ * run is long enough to time.
+ *
+ * transpose_parallel runs on a pool of -j threads (one per online CPU by
+ * default), and the matrices are first touched by that pool with the same
+ * split of tiles it transposes with (see trans_parallel.h). The "vs
+ * tiled" column compares each kernel's speed with transpose_tiled, the
+ * same tiles run serially.
+ *
+ * The in-place kernels are run on a copy of A in B's memory, each call
+ * transposing the last one's result back. The last column is the memory
+ * each kernel needs: both A and B, or just the one for an in-place kernel,
+ * plus any scratch buffer it uses.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include "cachelab.h"
+#include "trans_parallel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+//Most matrix sizes timed in one run
+#define MAX_SIZES 16
+
+//Smallest number of elements transposed per timed run
+#define MIN_RUN_ELEMENTS (1 << 20)
+
+//External transpose functions defined in trans.c, trans_simd.c and trans_parallel.c
+extern void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+extern void trans(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_recursive(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_sse2(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_avx2(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+extern void transpose_inplace_swap(int M, int N, int A[N][M]);
+extern void transpose_inplace_cycles(int M, int N, int A[N][M]);
+extern void transpose_inplace_blocked(int M, int N, int A[N][M]);
+extern long transpose_inplace_scratch(int M, int N);
+extern int simd_level(void);
+
+//Pool transpose_parallel runs on
+static transpose_pool *pool;
+
+/**
+ * Runs transpose_parallel on the benchmark's pool, so that it has the same signature as the other kernels.
+ */
+static void run_parallel(int M, int N, int A[N][M], int B[M][N]) {
+    transpose_parallel(pool, M, N, A, B);
+}
+
+/**
+ * Struct describing one kernel to time.
+ * @param name name printed in the results
+ * @param func the transpose function, or NULL for an in-place one
+ * @param simd simd_level the CPU needs to run it
+ * @param inplace the in-place transpose function, which is run on a copy of A in B's memory
+ * @param square_only whether the kernel only transposes square matrices
+ * @param scratch bytes the kernel uses besides the matrices to transpose an N x M matrix, or NULL if none
+ */
+typedef struct bench_kernel {
+    const char *name;
+    void (*func)(int M, int N, int[N][M], int[M][N]);
+    int simd;
+    void (*inplace)(int M, int N, int[N][M]);
+    bool square_only;
+    long (*scratch)(int M, int N);
+} bench_kernel;
+
+//transpose_tiled comes first, since every kernel is compared with it
+static bench_kernel kernels[] = {
+    {"transpose_tiled", transpose_tiled, 0},
+    {"transpose_parallel", run_parallel, 0},
+    {"transpose_submit", transpose_submit, 0},
+    {"trans", trans, 0},
+    {"transpose_recursive", transpose_recursive, 0},
+    {"transpose_sse2", transpose_sse2, 1},
+    {"transpose_avx2", transpose_avx2, 2},
+    {"transpose_simd", transpose_simd, 0},
+    {"transpose_inplace_swap", NULL, 0, transpose_inplace_swap, true},
+    {"transpose_inplace_cycles", NULL, 0, transpose_inplace_cycles},
+    {"transpose_inplace_blocked", NULL, 0, transpose_inplace_blocked, false, transpose_inplace_scratch},
+};
+
+/**
+ * Reads the wall clock.
+ * @return nanoseconds since an arbitrary point
+ */
+static unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Reads the time stamp counter, which counts reference cycles at a fixed rate.
+ * @return the counter, or 0 where there is none
+ */
+static unsigned long long now_ticks() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Checks that B is the transpose of A.
+ * @return whether it is
+ */
+static bool is_transposed(int M, int N, int A[N][M], int B[M][N]) {
+    for(int i = 0; i < N; i++) {
+        for(int j = 0; j < M; j++) {
+            if(A[i][j] != B[j][i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Times one kernel on one matrix size and prints a line of results.
+ * @param kernel kernel to time
+ * @param M number of columns of A
+ * @param N number of rows of A
+ * @param A filled in source matrix
+ * @param B destination matrix
+ * @param runs number of timed runs
+ * @param baseline nanoseconds per element of transpose_tiled at this size, or 0 if it is not known yet
+ * @return nanoseconds per element, or 0 if the kernel could not be timed
+ */
+static double bench(bench_kernel *kernel, int M, int N, int A[N][M], int B[M][N], int runs, double baseline) {
+    unsigned long long elements = (unsigned long long) M * N;
+    int repeat = elements >= MIN_RUN_ELEMENTS ? 1 : (int) (MIN_RUN_ELEMENTS / elements);
+
+    printf("%5dx%-5d %-25s", M, N, kernel->name);
+    if(kernel->simd > simd_level()) {
+        printf(" not supported by this CPU\n");
+        return 0;
+    }
+    if(kernel->square_only && M != N) {
+        printf(" only square matrices\n");
+        return 0;
+    }
+
+    //Check the result, which also brings the matrices into the caches
+    if(kernel->inplace) {
+        memcpy(B, A, sizeof(int) * elements);
+        kernel->inplace(M, N, (int (*)[M]) B);
+    } else {
+        memset(B, 0, sizeof(int) * elements);
+        kernel->func(M, N, A, B);
+    }
+    if(!is_transposed(M, N, A, B)) {
+        printf(" wrong result\n");
+        return 0;
+    }
+
+    bool transposed = true;
+    unsigned long long best_ns = ~0ULL;
+    unsigned long long best_ticks = ~0ULL;
+    for(int run = 0; run < runs; run++) {
+        unsigned long long start_ns = now_ns();
+        unsigned long long start_ticks = now_ticks();
+        for(int i = 0; i < repeat; i++) {
+            if(!kernel->inplace) {
+                kernel->func(M, N, A, B);
+            } else if(transposed) {
+                //Each in-place call transposes the last one's result back
+                kernel->inplace(N, M, B);
+            } else {
+                kernel->inplace(M, N, (int (*)[M]) B);
+            }
+            transposed = !transposed;
+        }
+        unsigned long long ticks = now_ticks() - start_ticks;
+        unsigned long long ns = now_ns() - start_ns;
+        if(ns < best_ns) {
+            best_ns = ns;
+        }
+        if(ticks < best_ticks) {
+            best_ticks = ticks;
+        }
+    }
+
+    //Each element is read from A and written to B once per transpose
+    double per_element = (double) elements * repeat;
+    double ns = best_ns / per_element;
+    //Memory is the matrices plus the larger of the scratch the kernel uses transposing A and transposing A^T back
+    double bytes = (kernel->inplace ? 1.0 : 2.0) * sizeof(int) * elements;
+    if(kernel->scratch) {
+        long there = kernel->scratch(M, N);
+        long back = kernel->scratch(N, M);
+        bytes += there > back ? there : back;
+    }
+    printf(" %10.3f %10.3f %10.2f %8.2fx %9.3f\n", ns, best_ticks / per_element, 2.0 * sizeof(int) / ns,
+           baseline > 0 ? baseline / ns : 1.0, bytes / 1e6);
+    return ns;
+}
+
+void print_usage() {
+    printf("Usage: ./transbench [-h] [-j <threads>] [-r <runs>] [-S <rows>x<cols>[,...]]\n");
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -j <n>      Threads for transpose_parallel (default one per online CPU).\n");
+    printf("  -r <runs>   Number of timed runs per kernel and size, the best is reported (default 20).\n");
+    printf("  -S <sizes>  Comma separated matrix sizes (default 32x32,64x64,61x67,256x256,1024x1024,4096x4096,\n");
+    printf("              1000x3000).\n");
+    printf("Example: ./transbench -j 8 -r 50 -S 512x512,2048x2048,20000x30000\n");
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 20;
+    int threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    const char *spec = "32x32,64x64,61x67,256x256,1024x1024,4096x4096,1000x3000";
+    int sizes[MAX_SIZES][2];
+    int num_sizes = 0;
+    const char *p;
+    int opt;
+
+    while((opt = getopt(argc, argv, "hj:r:S:")) != -1) {
+        switch(opt) {
+            case 'j':
+                threads = atoi(optarg);
+                if(threads < 1) {
+                    printf("Invalid number of threads \"%s\".\n", optarg);
+                    exit(0);
+                }
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                if(runs < 1) {
+                    runs = 1;
+                }
+                break;
+            case 'S':
+                spec = optarg;
+                break;
+            case 'h':
+            default:
+                print_usage();
+                exit(0);
+        }
+    }
+
+    for(p = spec; *p; p++) {
+        if(num_sizes == MAX_SIZES || sscanf(p, "%dx%d", &sizes[num_sizes][0], &sizes[num_sizes][1]) != 2 ||
+           sizes[num_sizes][0] < 1 || sizes[num_sizes][1] < 1) {
+            printf("Invalid matrix sizes \"%s\".\n", spec);
+            exit(0);
+        }
+        num_sizes++;
+        if(!(p = strchr(p, ','))) {
+            break;
+        }
+    }
+
+    if(threads < 1) {
+        threads = 1;
+    }
+    pool = transpose_pool_create(threads);
+
+    const char *levels[] = {"none", "sse2", "avx2"};
+    printf("SIMD support: %s. %d threads for transpose_parallel. Best of %d runs; ticks are time stamp counter\n",
+           levels[simd_level()], threads, runs);
+    printf("reference cycles.\n");
+    printf("%-11s %-25s %10s %10s %10s %9s %9s\n", "size", "kernel", "ns/elem", "ticks/elem", "GB/s", "vs tiled",
+           "memory MB");
+
+    for(int i = 0; i < num_sizes; i++) {
+        int M = sizes[i][0];
+        int N = sizes[i][1];
+        int (*A)[M] = malloc(sizeof(int) * M * N);
+        int (*B)[N] = malloc(sizeof(int) * M * N);
+        if(A == NULL || B == NULL) {
+            printf("Unable to allocate %dx%d matrices.\n", M, N);
+            exit(1);
+        }
+        transpose_pool_touch(pool, M, N, A, B);
+        for(int row = 0; row < N; row++) {
+            for(int col = 0; col < M; col++) {
+                A[row][col] = rand();
+            }
+        }
+
+        double baseline = 0;
+        for(int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            double ns = bench(&kernels[k], M, N, A, B, runs, baseline);
+            if(k == 0) {
+                baseline = ns;
+            }
+        }
+        free(A);
+        free(B);
+    }
+    transpose_pool_free(&pool);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * victim.c - Victim cache and miss cache beside the simulated cache
+ */
+
+#include "victim.h"
+#include <stdlib.h>
+#include <string.h>
+
+//Names accepted in a buffer spec, indexed by enum VictimKind
+static const char *victim_names[] = {"victim", "miss"};
+
+//Entries a buffer has when the spec does not say
+#define VICTIM_DEFAULT_ENTRIES 4
+
+/**
+ * Parses a buffer spec, kind[:entries].
+ * @param spec spec from the command line, e.g. "victim:8"
+ * @param config filled in with the buffer
+ * @return whether the spec was valid
+ */
+bool parse_victim_buffer(const char *spec, victim_config *config) {
+    const char *colon = strchr(spec, ':');
+    size_t name_length = colon != NULL ? (size_t) (colon - spec) : strlen(spec);
+    int kind = -1;
+    for(int i = 0; i < (int) (sizeof(victim_names) / sizeof(victim_names[0])); i++) {
+        if(strlen(victim_names[i]) == name_length && strncmp(spec, victim_names[i], name_length) == 0) {
+            kind = i;
+        }
+    }
+    if(kind < 0) {
+        return false;
+    }
+
+    config->kind = (enum VictimKind) kind;
+    config->entries = VICTIM_DEFAULT_ENTRIES;
+    if(colon != NULL) {
+        char *end;
+        config->entries = (int) strtol(colon + 1, &end, 10);
+        if(end == colon + 1 || *end != '\0') {
+            return false;
+        }
+    }
+    return config->entries >= 1 && config->entries <= VICTIM_MAX_ENTRIES;
+}
+
+/**
+ * Allocates an empty buffer.
+ * @param config what kind of buffer, as checked by parse_victim_buffer
+ * @return the buffer
+ */
+victim_buffer *victim_buffer_create(const victim_config *config) {
+    victim_buffer *vb = (victim_buffer *) malloc(sizeof(victim_buffer));
+    vb->config = *config;
+    vb->blocks = (unsigned long long *) malloc(sizeof(unsigned long long) * config->entries);
+    vb->stamps = (unsigned long long *) malloc(sizeof(unsigned long long) * config->entries);
+    victim_buffer_reset(vb);
+    return vb;
+}
+
+/**
+ * Empties a buffer.
+ * @param vb buffer to reset
+ */
+void victim_buffer_reset(victim_buffer *vb) {
+    memset(vb->stamps, 0, sizeof(unsigned long long) * vb->config.entries);
+    vb->clock = 0;
+}
+
+/**
+ * Frees a buffer.
+ * @param vb buffer to free, set to NULL
+ */
+void victim_buffer_free(victim_buffer **vb) {
+    free((*vb)->blocks);
+    free((*vb)->stamps);
+    free(*vb);
+    *vb = NULL;
+}
+
+/**
+ * Looks up a block the cache missed on. A victim cache gives the block up to the cache, a miss cache keeps it as its
+ * most recently used entry.
+ * @param vb buffer to search
+ * @param block block number (address >> b)
+ * @return whether the buffer held the block
+ */
+bool victim_buffer_lookup(victim_buffer *vb, unsigned long long block) {
+    for(int i = 0; i < vb->config.entries; i++) {
+        if(vb->stamps[i] != 0 && vb->blocks[i] == block) {
+            vb->stamps[i] = vb->config.kind == VICTIM_CACHE ? 0 : ++vb->clock;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Puts a block into the buffer as its most recently used entry, in an empty entry if there is one and otherwise in
+ * place of the least recently used one.
+ * @param vb buffer to fill
+ * @param block block number, which must not be in the buffer already
+ */
+void victim_buffer_insert(victim_buffer *vb, unsigned long long block) {
+    int replace = 0;
+    for(int i = 0; i < vb->config.entries; i++) {
+        if(vb->stamps[i] < vb->stamps[replace]) {
+            replace = i;
+        }
+    }
+    vb->blocks[replace] = block;
+    vb->stamps[replace] = ++vb->clock;
+}
@@ -0,0 +1,62 @@
+/*
+ * victim.h - Victim cache and miss cache beside the simulated cache
+ *
+ * Both are small fully associative LRU buffers of blocks that the cache
+ * consults when it misses, as described by Jouppi. A buffer is given as
+ * kind[:entries] (default 4 entries, at most VICTIM_MAX_ENTRIES):
+ *
+ *   victim  holds the lines the cache evicts. A miss that finds its block
+ *           here swaps it with the line the cache evicts for it, so a
+ *           block is never in both.
+ *   miss    holds a copy of every block the cache missed on, whether or
+ *           not the cache kept it.
+ *
+ * The cache itself fills and evicts exactly as it would alone, so its
+ * hits, misses and evictions do not change. What the buffer adds is how
+ * many of those misses it would have served without going to the next
+ * level, and for a victim cache how many of them swapped a line back in.
+ */
+
+#ifndef VICTIM_H
+#define VICTIM_H
+
+#include <stdbool.h>
+
+//Largest buffer, which is searched entry by entry
+#define VICTIM_MAX_ENTRIES 64
+
+//Enum of the supported buffers
+enum VictimKind {VICTIM_CACHE, MISS_CACHE};
+
+/**
+ * Struct describing a buffer.
+ * @param kind victim cache or miss cache
+ * @param entries number of blocks it holds
+ */
+typedef struct victim_config {
+    enum VictimKind kind;
+    int entries;
+} victim_config;
+
+/**
+ * Struct holding a buffer's blocks.
+ * @param config what kind of buffer it is
+ * @param blocks block held by each entry
+ * @param stamps value of clock when each entry was last used, 0 for an empty entry
+ * @param clock lookup and insert counter used to stamp entries
+ */
+typedef struct victim_buffer {
+    victim_config config;
+    unsigned long long *blocks;
+    unsigned long long *stamps;
+    unsigned long long clock;
+} victim_buffer;
+
+bool parse_victim_buffer(const char *spec, victim_config *config);
+victim_buffer *victim_buffer_create(const victim_config *config);
+bool victim_buffer_lookup(victim_buffer *vb, unsigned long long block);
+void victim_buffer_insert(victim_buffer *vb, unsigned long long block);
+void victim_buffer_reset(victim_buffer *vb);
+void victim_buffer_free(victim_buffer **vb);
+
+#endif /* VICTIM_H */